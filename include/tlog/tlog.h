@@ -32,12 +32,78 @@ typedef enum
 
 typedef struct _tlog_category tlog_category;
 
+/* 
+ * public head of category, always the first member of category,
+ * level_mask is OR of all rule level masks, updated atomically
+ */
+typedef struct
+{
+    unsigned int level_mask;
+}tlog_category_head;
+
+/* static call site information, one for each log statement */
+typedef struct
+{
+    const char *file;
+    /* file name without directory, NULL means unknown */
+    const char *filename;
+    const char *func;
+    const char *line_str;
+    long line;
+    int level;
+}tlog_callsite;
+
 extern int tlog_open(const char *name, tlog_source source);
 extern void tlog_close(void);
 extern const tlog_category *tlog_get_category(const char *name);
-extern void tlog(const tlog_category *cat, const char *file,
-        long line, const char *func, const char *line_str,
-        int level, const char *fmt, ...) __attribute__ ((__format__ (__printf__, 7, 8)));
+extern void tlog(const tlog_category *cat, const tlog_callsite *site,
+        const char *fmt, ...) __attribute__ ((__format__ (__printf__, 3, 4)));
+
+/* per call site rate limit state, zero initialized */
+typedef struct
+{
+    /* calls of every_n/first_n */
+    unsigned long count;
+    /* records suppressed since last output */
+    unsigned long suppressed;
+    /* ratelimit theoretical arrival time in nanoseconds */
+    unsigned long long tat;
+}tlog_limit;
+
+/* rate limited log interface, use tlog_xxx_every_n/first_n/ratelimit instead */
+extern int tlog_ratelimit_check(tlog_limit *limit, unsigned int per_sec,
+        unsigned int burst, unsigned long *suppressed);
+extern void tlog_limited(const tlog_category *cat, const tlog_callsite *site,
+        unsigned long suppressed, const char *fmt, ...)
+    __attribute__ ((__format__ (__printf__, 4, 5)));
+
+/* structured field type */
+typedef enum
+{
+    TLOG_FIELD_STR,
+    TLOG_FIELD_INT,
+    TLOG_FIELD_UINT,
+    TLOG_FIELD_DOUBLE,
+    TLOG_FIELD_BOOL,
+}tlog_field_type;
+
+/* structured key-value field */
+typedef struct
+{
+    const char *key;
+    tlog_field_type type;
+    union
+    {
+        const char *s;
+        long long i;
+        unsigned long long u;
+        double d;
+    }value;
+}tlog_field;
+
+/* structured log interface, use tlog_kv macro instead */
+extern void tlog_kv_write(const tlog_category *cat, const tlog_callsite *site,
+        const char *msg, const tlog_field *fields, unsigned int count);
 
 /* mdc interface */
 extern int tlog_put_mdc(const char *key, const char *value);
@@ -58,18 +124,318 @@ extern void tlog_clean_mdc(void);
     #define __func__ "<unknown>"
 #endif
 
+/* file name without directory, resolved at compile time if possible */
+#ifdef __FILE_NAME__
+    #define TLOG_FILE_NAME __FILE_NAME__
+#else
+    #define TLOG_FILE_NAME 0
+#endif
+
+/* 
+ * compile time level threshold, log macros below TLOG_MIN_LEVEL
+ * expand to nothing, define it before include this file, 
+ * e.g. -DTLOG_MIN_LEVEL=TLOG_LEVEL_INFO
+ */
+#define TLOG_LEVEL_DEBUG     0
+#define TLOG_LEVEL_INFO      1
+#define TLOG_LEVEL_NOTICE    2
+#define TLOG_LEVEL_WARN      3
+#define TLOG_LEVEL_ERROR     4
+#define TLOG_LEVEL_FATAL     5
+#define TLOG_LEVEL_OFF       6
+
+#ifndef TLOG_MIN_LEVEL
+    #define TLOG_MIN_LEVEL TLOG_LEVEL_DEBUG
+#endif
+
+/* never called, only type check stripped log arguments */
+static inline void tlog_discard(const tlog_category *cat, const char *fmt, ...)
+    __attribute__ ((__format__ (__printf__, 2, 3)));
+static inline void tlog_discard(const tlog_category *cat, const char *fmt, ...)
+{
+    (void)cat;
+    (void)fmt;
+}
+
+#define TLOG_DISCARD(cat, ...) \
+    (0 ? tlog_discard(cat, __VA_ARGS__) : (void)0)
+
+/* type check stripped rate limit arguments */
+#define TLOG_DISCARD_LIMIT(cat, limit, ...) \
+    (0 ? (void)(limit) : TLOG_DISCARD(cat, __VA_ARGS__))
+
+/* check if any rule of category accepts level, NULL category is disabled */
+static inline int tlog_enabled(const tlog_category *cat, int level)
+{
+    return (0 != cat) &&
+        (0 != (__atomic_load_n(&((const tlog_category_head *)cat)->level_mask,
+                               __ATOMIC_RELAXED) & (unsigned int)level));
+}
+
+/* define static call site named _tlog_site */
+#define TLOG_CALLSITE(level) \
+    static const tlog_callsite _tlog_site = \
+    { \
+        __FILE__, TLOG_FILE_NAME, __func__, STR(__LINE__), __LINE__, level \
+    }
+
+/* 
+ * check level inline and pass static call site to tlog,
+ * evaluate cat only once
+ */
+#define TLOG_LOG(cat, level, ...) \
+    do \
+    { \
+        TLOG_CALLSITE(level); \
+        const tlog_category *_tlog_cat = (cat); \
+        if (tlog_enabled(_tlog_cat, level)) \
+        { \
+            tlog(_tlog_cat, &_tlog_site, __VA_ARGS__); \
+        } \
+    } while (0)
+
+/* output every n-th call, n - 1 calls are suppressed between outputs */
+static inline int tlog_every_n_check(tlog_limit *limit, unsigned long n,
+        unsigned long *suppressed)
+{
+    unsigned long count = __atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED);
+    if ((n > 1) && (0 != count % n))
+    {
+        return 0;
+    }
+    *suppressed = ((0 == count) || (n <= 1)) ? 0 : n - 1;
+    return 1;
+}
+
+/* output first n calls, stop counting after that */
+static inline int tlog_first_n_check(tlog_limit *limit, unsigned long n)
+{
+    if (__atomic_load_n(&limit->count, __ATOMIC_RELAXED) >= n)
+    {
+        return 0;
+    }
+    return __atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED) < n;
+}
+
+/* 
+ * rate limited log, each call site has its own static limit state,
+ * check is evaluated before any argument is formatted, suppressed
+ * count is appended to the next output message
+ */
+#define TLOG_LOG_LIMITED(cat, level, check, ...) \
+    do \
+    { \
+        TLOG_CALLSITE(level); \
+        static tlog_limit _tlog_limit; \
+        const tlog_category *_tlog_cat = (cat); \
+        if (tlog_enabled(_tlog_cat, level)) \
+        { \
+            unsigned long _tlog_suppressed = 0; \
+            if (check) \
+            { \
+                tlog_limited(_tlog_cat, &_tlog_site, _tlog_suppressed, \
+                        __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#define TLOG_LOG_EVERY_N(cat, level, n, ...) \
+    TLOG_LOG_LIMITED(cat, level, \
+            tlog_every_n_check(&_tlog_limit, n, &_tlog_suppressed), __VA_ARGS__)
+
+#define TLOG_LOG_FIRST_N(cat, level, n, ...) \
+    TLOG_LOG_LIMITED(cat, level, \
+            tlog_first_n_check(&_tlog_limit, n), __VA_ARGS__)
+
+#define TLOG_LOG_RATELIMIT(cat, level, per_sec, burst, ...) \
+    TLOG_LOG_LIMITED(cat, level, \
+            tlog_ratelimit_check(&_tlog_limit, per_sec, burst, &_tlog_suppressed), \
+            __VA_ARGS__)
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_DEBUG
 #define tlog_debug(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_DEBUG, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_DEBUG, __VA_ARGS__)
+#define tlog_debug_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_DEBUG, n, __VA_ARGS__)
+#define tlog_debug_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_DEBUG, n, __VA_ARGS__)
+#define tlog_debug_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_DEBUG, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_debug(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_debug_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_debug_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_debug_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_INFO
 #define tlog_info(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_INFO, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_INFO, __VA_ARGS__)
+#define tlog_info_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_INFO, n, __VA_ARGS__)
+#define tlog_info_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_INFO, n, __VA_ARGS__)
+#define tlog_info_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_INFO, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_info(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_info_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_info_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_info_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_NOTICE
 #define tlog_notice(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_NOTICE, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_NOTICE, __VA_ARGS__)
+#define tlog_notice_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_NOTICE, n, __VA_ARGS__)
+#define tlog_notice_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_NOTICE, n, __VA_ARGS__)
+#define tlog_notice_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_NOTICE, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_notice(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_notice_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_notice_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_notice_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_WARN
 #define tlog_warn(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_WARN, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_WARN, __VA_ARGS__)
+#define tlog_warn_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_WARN, n, __VA_ARGS__)
+#define tlog_warn_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_WARN, n, __VA_ARGS__)
+#define tlog_warn_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_WARN, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_warn(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_warn_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_warn_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_warn_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_ERROR
 #define tlog_error(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_ERROR, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_ERROR, __VA_ARGS__)
+#define tlog_error_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_ERROR, n, __VA_ARGS__)
+#define tlog_error_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_ERROR, n, __VA_ARGS__)
+#define tlog_error_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_ERROR, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_error(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_error_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_error_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_error_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+#if TLOG_MIN_LEVEL <= TLOG_LEVEL_FATAL
 #define tlog_fatal(cat, ...) \
-    tlog(cat, __FILE__, __LINE__, __func__, STR(__LINE__), TLOG_FATAL, __VA_ARGS__)
+    TLOG_LOG(cat, TLOG_FATAL, __VA_ARGS__)
+#define tlog_fatal_every_n(cat, n, ...) \
+    TLOG_LOG_EVERY_N(cat, TLOG_FATAL, n, __VA_ARGS__)
+#define tlog_fatal_first_n(cat, n, ...) \
+    TLOG_LOG_FIRST_N(cat, TLOG_FATAL, n, __VA_ARGS__)
+#define tlog_fatal_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_LOG_RATELIMIT(cat, TLOG_FATAL, per_sec, burst, __VA_ARGS__)
+#else
+#define tlog_fatal(cat, ...) TLOG_DISCARD(cat, __VA_ARGS__)
+#define tlog_fatal_every_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_fatal_first_n(cat, n, ...) \
+    TLOG_DISCARD_LIMIT(cat, n, __VA_ARGS__)
+#define tlog_fatal_ratelimit(cat, per_sec, burst, ...) \
+    TLOG_DISCARD_LIMIT(cat, (per_sec) + (burst), __VA_ARGS__)
+#endif
+
+/* structured field constructors */
+static inline tlog_field tlog_field_str(const char *key, const char *value)
+{
+    tlog_field field;
+    field.key = key;
+    field.type = TLOG_FIELD_STR;
+    field.value.s = value;
+    return field;
+}
+
+static inline tlog_field tlog_field_int(const char *key, long long value)
+{
+    tlog_field field;
+    field.key = key;
+    field.type = TLOG_FIELD_INT;
+    field.value.i = value;
+    return field;
+}
+
+static inline tlog_field tlog_field_uint(const char *key, unsigned long long value)
+{
+    tlog_field field;
+    field.key = key;
+    field.type = TLOG_FIELD_UINT;
+    field.value.u = value;
+    return field;
+}
+
+static inline tlog_field tlog_field_double(const char *key, double value)
+{
+    tlog_field field;
+    field.key = key;
+    field.type = TLOG_FIELD_DOUBLE;
+    field.value.d = value;
+    return field;
+}
+
+static inline tlog_field tlog_field_bool(const char *key, int value)
+{
+    tlog_field field;
+    field.key = key;
+    field.type = TLOG_FIELD_BOOL;
+    field.value.i = (0 != value);
+    return field;
+}
+
+#define TLOG_STR(key, value)     tlog_field_str(key, value)
+#define TLOG_INT(key, value)     tlog_field_int(key, value)
+#define TLOG_UINT(key, value)    tlog_field_uint(key, value)
+#define TLOG_DOUBLE(key, value)  tlog_field_double(key, value)
+#define TLOG_BOOL(key, value)    tlog_field_bool(key, value)
+
+/* 
+ * structured log, level must be constant, fields are rendered
+ * by %K(logfmt) or %J(json) in format, e.g.
+ * tlog_kv(cat, TLOG_INFO, "login", TLOG_STR("user", u), TLOG_INT("ms", n));
+ */
+#define tlog_kv(cat, level, msg, ...) \
+    do \
+    { \
+        TLOG_CALLSITE(level); \
+        const tlog_category *_tlog_cat = (cat); \
+        if ((((level) & 0xff) >= TLOG_MIN_LEVEL) && \
+            tlog_enabled(_tlog_cat, level)) \
+        { \
+            const tlog_field _tlog_fields[] = {__VA_ARGS__}; \
+            tlog_kv_write(_tlog_cat, &_tlog_site, msg, _tlog_fields, \
+                    sizeof(_tlog_fields) / sizeof(_tlog_fields[0])); \
+        } \
+    } while (0)
 
 
 #ifdef  __cplusplus
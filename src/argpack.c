@@ -0,0 +1,687 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <wchar.h>
+#include "tassert.h"
+#include "argpack.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+/* every packed value is aligned to 8 bytes */
+#define ARGPACK_ALIGN           8
+#define ARGPACK_ALIGN_UP(len)   (((len) + ARGPACK_ALIGN - 1) & ~(ARGPACK_ALIGN - 1))
+/* max conversion specification length */
+#define ARGPACK_SPEC_MAX        32
+
+/* print one value with conversion specification */
+#define ARGPACK_PRINT(value) \
+    do \
+    { \
+        tchar *dst = (written < size) ? buf + written : NULL; \
+        tuint32 avail = (written < size) ? size - written : 0; \
+        tint ret = 0; \
+        if (0 == spec.stars) \
+        { \
+            ret = snprintf(dst, avail, spec_buf, value); \
+        } \
+        else if (1 == spec.stars) \
+        { \
+            ret = snprintf(dst, avail, spec_buf, star[0], value); \
+        } \
+        else \
+        { \
+            ret = snprintf(dst, avail, spec_buf, star[0], star[1], value); \
+        } \
+        if (ret > 0) \
+        { \
+            written += ret; \
+        } \
+    } while (0)
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+/* argument class */
+typedef enum
+{
+    ARG_NONE,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_WINT,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_WSTR,
+    /* %m, strerror(errno) */
+    ARG_ERRNO,
+    /* %n, argument ignored */
+    ARG_COUNT,
+}arg_class;
+
+/* conversion specification */
+typedef struct
+{
+    /* length from '%' to conversion character */
+    tuint32 len;
+    /* '*' count of width and precision */
+    tuint32 stars;
+    /* precision, -1 means not specified */
+    tint prec;
+    /* precision is the last '*' argument */
+    tbool prec_star;
+    arg_class cls;
+}conv_spec;
+
+/****************************************************
+ * static variable
+ ****************************************************/
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief parse conversion specification
+ * @param fmt - format string, point to '%'
+ * @param spec - conversion specification output
+ * @return TRUE: valid specification
+ *         FALSE: unsupported specification
+ */
+static tbool parse_spec(const tchar *fmt, conv_spec *spec)
+{
+    T_ASSERT('%' == *fmt);
+
+    const tchar *p = fmt + 1;
+    tuint32 length = 0;
+    spec->stars = 0;
+    spec->prec = -1;
+    spec->prec_star = FALSE;
+    spec->cls = ARG_NONE;
+
+    if ('%' == *p)
+    {
+        spec->len = 2;
+        return TRUE;
+    }
+
+    /* flags */
+    while (('\0' != *p) && (NULL != strchr("-+ #0'I", *p)))
+    {
+        p++;
+    }
+
+    /* width */
+    if ('*' == *p)
+    {
+        spec->stars ++;
+        p++;
+    }
+    else
+    {
+        while ((*p >= '0') && (*p <= '9'))
+        {
+            p++;
+        }
+    }
+
+    /* positional argument is not supported */
+    if ('$' == *p)
+    {
+        return FALSE;
+    }
+
+    /* precision */
+    if ('.' == *p)
+    {
+        p++;
+        if ('*' == *p)
+        {
+            spec->stars ++;
+            spec->prec_star = TRUE;
+            p++;
+        }
+        else
+        {
+            spec->prec = 0;
+            while ((*p >= '0') && (*p <= '9'))
+            {
+                if (spec->prec < 0x7fffffff / 10)
+                {
+                    spec->prec = spec->prec * 10 + (*p - '0');
+                }
+                p++;
+            }
+        }
+    }
+
+    /* length modifier */
+    switch (*p)
+    {
+    case 'h':
+        p++;
+        if ('h' == *p)
+        {
+            p++;
+        }
+        break;
+    case 'l':
+        p++;
+        length = 'l';
+        if ('l' == *p)
+        {
+            p++;
+            length = 'q';
+        }
+        break;
+    case 'L':
+    case 'q':
+    case 'j':
+    case 'z':
+    case 'Z':
+    case 't':
+        length = *p;
+        p++;
+        break;
+    default:
+        break;
+    }
+
+    /* conversion */
+    switch (*p)
+    {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        switch (length)
+        {
+        case 'l':
+            spec->cls = ARG_LONG;
+            break;
+        case 'q':
+        case 'L':
+            spec->cls = ARG_LLONG;
+            break;
+        case 'j':
+            spec->cls = ARG_INTMAX;
+            break;
+        case 'z':
+        case 'Z':
+            spec->cls = ARG_SIZE;
+            break;
+        case 't':
+            spec->cls = ARG_PTRDIFF;
+            break;
+        default:
+            spec->cls = ARG_INT;
+            break;
+        }
+        break;
+    case 'c':
+        spec->cls = ('l' == length) ? ARG_WINT : ARG_INT;
+        break;
+    case 'C':
+        spec->cls = ARG_WINT;
+        break;
+    case 's':
+        spec->cls = ('l' == length) ? ARG_WSTR : ARG_STR;
+        break;
+    case 'S':
+        spec->cls = ARG_WSTR;
+        break;
+    case 'p':
+        spec->cls = ARG_PTR;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->cls = ('L' == length) ? ARG_LDOUBLE : ARG_DOUBLE;
+        break;
+    case 'm':
+        spec->cls = ARG_ERRNO;
+        break;
+    case 'n':
+        spec->cls = ARG_COUNT;
+        break;
+    default:
+        return FALSE;
+    }
+
+    spec->len = p - fmt + 1;
+    return (spec->len < ARGPACK_SPEC_MAX);
+}
+
+/**
+ * @brief store integer value to pack buffer
+ * @param buf - pack buffer, NULL means calculate size only
+ * @param offset - current offset
+ * @param value - integer value
+ * @return new offset
+ */
+static tuint32 store_int(tchar *buf, tuint32 offset, tint64 value)
+{
+    if (NULL != buf)
+    {
+        memcpy(buf + offset, &value, sizeof(value));
+    }
+    return offset + ARGPACK_ALIGN_UP(sizeof(value));
+}
+
+/**
+ * @brief store string to pack buffer, terminator is appended
+ * @param buf - pack buffer, NULL means calculate size only
+ * @param offset - current offset
+ * @param data - string data
+ * @param len - string data length, not including terminator
+ * @param unit - character size
+ * @return new offset
+ */
+static tuint32 store_data(tchar *buf, tuint32 offset, const void *data, tuint32 len,
+        tuint32 unit)
+{
+    tuint32 total = len + unit;
+    if (NULL != buf)
+    {
+        memcpy(buf + offset, &total, sizeof(total));
+        memcpy(buf + offset + ARGPACK_ALIGN, data, len);
+        memset(buf + offset + ARGPACK_ALIGN + len, 0, unit);
+    }
+    return offset + ARGPACK_ALIGN + ARGPACK_ALIGN_UP(total);
+}
+
+/**
+ * @brief walk format string and pack arguments
+ * @param buf - pack buffer, NULL means calculate size only
+ * @param fmt - format string
+ * @param args - arguments
+ * @return packed size, -1 means format not supported
+ */
+static tint argpack_walk(tchar *buf, const tchar *fmt, va_list args)
+{
+    T_ASSERT(NULL != fmt);
+
+    tint err = errno;
+    tuint32 offset = 0;
+    conv_spec spec;
+    const tchar *p = fmt;
+
+    while ('\0' != *p)
+    {
+        if ('%' != *p)
+        {
+            p++;
+            continue;
+        }
+
+        if (!parse_spec(p, &spec))
+        {
+            return -1;
+        }
+        p += spec.len;
+
+        tint prec = spec.prec;
+        for (tuint32 i = 0; i < spec.stars; ++i)
+        {
+            tint star = va_arg(args, int);
+            offset = store_int(buf, offset, star);
+            /* negative precision is taken as omitted */
+            if (spec.prec_star && (i + 1 == spec.stars))
+            {
+                prec = (star >= 0) ? star : -1;
+            }
+        }
+
+        switch (spec.cls)
+        {
+        case ARG_NONE:
+            break;
+        case ARG_INT:
+            offset = store_int(buf, offset, va_arg(args, int));
+            break;
+        case ARG_LONG:
+            offset = store_int(buf, offset, va_arg(args, long));
+            break;
+        case ARG_LLONG:
+            offset = store_int(buf, offset, va_arg(args, long long));
+            break;
+        case ARG_SIZE:
+            offset = store_int(buf, offset, va_arg(args, size_t));
+            break;
+        case ARG_INTMAX:
+            offset = store_int(buf, offset, va_arg(args, intmax_t));
+            break;
+        case ARG_PTRDIFF:
+            offset = store_int(buf, offset, va_arg(args, ptrdiff_t));
+            break;
+        case ARG_WINT:
+            offset = store_int(buf, offset, va_arg(args, wint_t));
+            break;
+        case ARG_PTR:
+            offset = store_int(buf, offset, (intptr_t)va_arg(args, void *));
+            break;
+        case ARG_DOUBLE:
+        {
+            double value = va_arg(args, double);
+            if (NULL != buf)
+            {
+                memcpy(buf + offset, &value, sizeof(value));
+            }
+            offset += ARGPACK_ALIGN_UP(sizeof(value));
+        }
+            break;
+        case ARG_LDOUBLE:
+        {
+            long double value = va_arg(args, long double);
+            if (NULL != buf)
+            {
+                memcpy(buf + offset, &value, sizeof(value));
+            }
+            offset += ARGPACK_ALIGN_UP(sizeof(value));
+        }
+            break;
+        case ARG_STR:
+        {
+            const tchar *str = va_arg(args, const tchar *);
+            if (NULL == str)
+            {
+                str = "(null)";
+            }
+            /* string with precision may not be terminated */
+            size_t len = (prec >= 0) ? strnlen(str, prec) : strlen(str);
+            offset = store_data(buf, offset, str, len, 1);
+        }
+            break;
+        case ARG_WSTR:
+        {
+            const wchar_t *str = va_arg(args, const wchar_t *);
+            if (NULL == str)
+            {
+                str = L"(null)";
+            }
+            /* precision counts output bytes, at least one per character */
+            size_t len = (prec >= 0) ? wcsnlen(str, prec) : wcslen(str);
+            offset = store_data(buf, offset, str, len * sizeof(wchar_t),
+                    sizeof(wchar_t));
+        }
+            break;
+        case ARG_ERRNO:
+        {
+            const tchar *str = strerror(err);
+            offset = store_data(buf, offset, str, strlen(str), 1);
+        }
+            break;
+        case ARG_COUNT:
+            va_arg(args, void *);
+            break;
+        }
+    }
+
+    return offset;
+}
+
+/**
+ * @brief calculate packed size of arguments
+ * @param fmt - printf format string
+ * @param args - arguments, can not be used after call
+ * @return packed size, -1 means format not supported
+ */
+tint argpack_size(const tchar *fmt, va_list args)
+{
+    return argpack_walk(NULL, fmt, args);
+}
+
+/**
+ * @brief pack arguments to buffer, strings are deep copied
+ * @param buf - pack buffer, must be 8 bytes aligned and
+ *              large enough to hold argpack_size() bytes
+ * @param fmt - printf format string
+ * @param args - arguments, can not be used after call
+ * @return packed size, -1 means format not supported
+ */
+tint argpack_pack(tchar *buf, const tchar *fmt, va_list args)
+{
+    T_ASSERT(NULL != buf);
+    return argpack_walk(buf, fmt, args);
+}
+
+/**
+ * @brief load integer value from pack buffer
+ * @param packed - packed arguments
+ * @param packed_len - packed arguments length
+ * @param offset - current offset, moved after value
+ * @param value - value output
+ * @param len - value length
+ * @return TRUE: success, FALSE: out of packed arguments
+ */
+static tbool load_value(const tchar *packed, tuint32 packed_len,
+        tuint32 *offset, void *value, tuint32 len)
+{
+    if ((*offset > packed_len) || (packed_len - *offset < len))
+    {
+        return FALSE;
+    }
+    memcpy(value, packed + *offset, len);
+    *offset += ARGPACK_ALIGN_UP(len);
+    return TRUE;
+}
+
+/**
+ * @brief load string from pack buffer
+ * @param packed - packed arguments
+ * @param packed_len - packed arguments length
+ * @param offset - current offset, moved after string
+ * @param unit - character size
+ * @param str - string output
+ * @return TRUE: success, FALSE: out of packed arguments or not terminated
+ */
+static tbool load_data(const tchar *packed, tuint32 packed_len,
+        tuint32 *offset, tuint32 unit, const void **str)
+{
+    tuint32 len = 0;
+    if ((*offset > packed_len) || (packed_len - *offset < ARGPACK_ALIGN))
+    {
+        return FALSE;
+    }
+    memcpy(&len, packed + *offset, sizeof(len));
+
+    static const tchar zero[sizeof(wchar_t)] = {0};
+    const tchar *data = packed + *offset + ARGPACK_ALIGN;
+    if ((len < unit) || (0 != len % unit) ||
+        (packed_len - *offset - ARGPACK_ALIGN < len) ||
+        (0 != memcmp(data + len - unit, zero, unit)))
+    {
+        return FALSE;
+    }
+    *str = data;
+    *offset += ARGPACK_ALIGN + ARGPACK_ALIGN_UP(len);
+    return TRUE;
+}
+
+/**
+ * @brief render packed arguments like snprintf
+ * @param buf - output buffer
+ * @param size - output buffer size
+ * @param fmt - printf format string used to pack
+ * @param packed - packed arguments
+ * @param packed_len - packed arguments length
+ * @return length of the full message, output is
+ *         truncated when it is not less than size,
+ *         -1 means packed arguments do not match format
+ */
+tint argpack_render(tchar *buf, tuint32 size, const tchar *fmt,
+        const tchar *packed, tuint32 packed_len)
+{
+    T_ASSERT(NULL != fmt);
+    T_ASSERT((NULL != packed) || (0 == packed_len));
+
+    tuint32 written = 0;
+    tuint32 offset = 0;
+    conv_spec spec;
+    tchar spec_buf[ARGPACK_SPEC_MAX];
+    tint star[2] = {0, 0};
+    tint64 value = 0;
+    const tchar *p = fmt;
+    const tchar *literal = NULL;
+
+    while ('\0' != *p)
+    {
+        /* copy literal */
+        literal = p;
+        while (('\0' != *p) && ('%' != *p))
+        {
+            p++;
+        }
+
+        if (p != literal)
+        {
+            if (written < size)
+            {
+                memcpy(buf + written, literal, MIN(p - literal, size - written));
+            }
+            written += p - literal;
+        }
+
+        if ('\0' == *p)
+        {
+            break;
+        }
+
+        if (!parse_spec(p, &spec))
+        {
+            /* can not happen with a pack made from same format */
+            return -1;
+        }
+
+        memcpy(spec_buf, p, spec.len);
+        spec_buf[spec.len] = '\0';
+        p += spec.len;
+
+        for (tuint32 i = 0; i < spec.stars; ++i)
+        {
+            if (!load_value(packed, packed_len, &offset, &value, sizeof(value)))
+            {
+                return -1;
+            }
+            star[i] = (tint)value;
+        }
+
+        switch (spec.cls)
+        {
+        case ARG_NONE:
+            if (written < size)
+            {
+                buf[written] = '%';
+            }
+            written ++;
+            break;
+        case ARG_INT:
+        case ARG_LONG:
+        case ARG_LLONG:
+        case ARG_SIZE:
+        case ARG_INTMAX:
+        case ARG_PTRDIFF:
+        case ARG_WINT:
+        case ARG_PTR:
+            if (!load_value(packed, packed_len, &offset, &value, sizeof(value)))
+            {
+                return -1;
+            }
+            switch (spec.cls)
+            {
+            case ARG_INT:
+                ARGPACK_PRINT((int)value);
+                break;
+            case ARG_LONG:
+                ARGPACK_PRINT((long)value);
+                break;
+            case ARG_LLONG:
+                ARGPACK_PRINT((long long)value);
+                break;
+            case ARG_SIZE:
+                ARGPACK_PRINT((size_t)value);
+                break;
+            case ARG_INTMAX:
+                ARGPACK_PRINT((intmax_t)value);
+                break;
+            case ARG_PTRDIFF:
+                ARGPACK_PRINT((ptrdiff_t)value);
+                break;
+            case ARG_WINT:
+                ARGPACK_PRINT((wint_t)value);
+                break;
+            default:
+                ARGPACK_PRINT((void *)(intptr_t)value);
+                break;
+            }
+            break;
+        case ARG_DOUBLE:
+        {
+            double dvalue;
+            if (!load_value(packed, packed_len, &offset, &dvalue, sizeof(dvalue)))
+            {
+                return -1;
+            }
+            ARGPACK_PRINT(dvalue);
+        }
+            break;
+        case ARG_LDOUBLE:
+        {
+            long double ldvalue;
+            if (!load_value(packed, packed_len, &offset, &ldvalue, sizeof(ldvalue)))
+            {
+                return -1;
+            }
+            ARGPACK_PRINT(ldvalue);
+        }
+            break;
+        case ARG_ERRNO:
+            /* errno string is captured as string */
+            spec_buf[spec.len - 1] = 's';
+            /* fall through */
+        case ARG_STR:
+        case ARG_WSTR:
+        {
+            const void *str = NULL;
+            tuint32 unit = (ARG_WSTR == spec.cls) ? sizeof(wchar_t) : 1;
+            if (!load_data(packed, packed_len, &offset, unit, &str))
+            {
+                return -1;
+            }
+            ARGPACK_PRINT(str);
+        }
+            break;
+        case ARG_COUNT:
+            break;
+        }
+    }
+
+    /* always terminated */
+    if (size > 0)
+    {
+        buf[MIN(written, size - 1)] = '\0';
+    }
+
+    return written;
+}
@@ -0,0 +1,27 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _ARGPACK_H_
+#define _ARGPACK_H_
+
+#include <stdarg.h>
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+/*
+ * argument pack, capture printf arguments into a flat buffer
+ * and render them later without the original va_list
+ */
+T_EXTERN tint argpack_size(const tchar *fmt, va_list args);
+T_EXTERN tint argpack_pack(tchar *buf, const tchar *fmt, va_list args);
+T_EXTERN tint argpack_render(tchar *buf, tuint32 size, const tchar *fmt,
+        const tchar *packed, tuint32 packed_len);
+
+T_END_DECLS
+
+#endif /* _ARGPACK_H_ */
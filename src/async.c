@@ -0,0 +1,695 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#ifdef __GLIBC__
+#include <stdio_ext.h>
+#endif
+#include "tassert.h"
+#include "tlist.h"
+#include "async.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+/* record alignment, must not be less than record header size */
+#define ASYNC_ALIGN            16
+#define ASYNC_ALIGN_UP(len)    (((len) + ASYNC_ALIGN - 1) & ~(ASYNC_ALIGN - 1))
+#define ASYNC_CACHE_LINE       64
+#define ASYNC_RING_MIN_SIZE    4096
+/* max records written by one writev */
+#ifdef IOV_MAX
+#define ASYNC_IOV_MAX          ((IOV_MAX < 1024) ? IOV_MAX : 1024)
+#else
+#define ASYNC_IOV_MAX          16
+#endif
+/*
+ * records less than this are copied into stream buffer, writev
+ * does not save anything when stream would batch them anyway
+ */
+#define ASYNC_WRITEV_MIN       16384
+/* stream buffer size, assume default size where it can not be queried */
+#ifdef __GLIBC__
+#define ASYNC_STREAM_BUFSIZE(fd)    __fbufsize(fd)
+#else
+#define ASYNC_STREAM_BUFSIZE(fd)    BUFSIZ
+#endif
+/* writer idle wait time */
+#define ASYNC_IDLE_WAIT_NS     10000000
+
+/* record type */
+#define ASYNC_RECORD_DATA      0
+#define ASYNC_RECORD_WRAP      1
+#define ASYNC_RECORD_DEFERRED  2
+#define ASYNC_RECORD_FLUSH     3
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+/* record header, payload follows */
+typedef struct
+{
+    tuint32 len;
+    tuint32 type;
+    union
+    {
+        FILE *fd;
+        async_write_func func;
+    }target;
+}async_record;
+
+/*
+ * single producer single consumer ring, producer is the
+ * owner thread, consumer is the writer thread
+ */
+typedef struct
+{
+    /* written by writer thread only */
+    tuint64 tail;
+    tchar pad_tail[ASYNC_CACHE_LINE - sizeof(tuint64)];
+    /* written by owner thread only */
+    tuint64 head;
+    tuint64 tail_cache;
+    /* reserved record, published on commit */
+    tuint64 reserved_head;
+    async_record *reserved;
+    tchar pad_head[ASYNC_CACHE_LINE - 3 * sizeof(tuint64) - sizeof(async_record *)];
+    /* owner thread exited */
+    tbool orphan;
+    tuint32 size;
+    tchar *buf;
+    tlist node;
+}async_ring;
+
+struct _async_logger
+{
+    tuint32 ring_size;
+    pthread_key_t key;
+    /* protect ring list and writer sleep */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    tlist rings;
+    tbool running;
+    tbool sleeping;
+    pthread_t writer;
+    /* rings copied from list, drained without lock, writer thread only */
+    async_ring **drain_rings;
+    tuint32 drain_size;
+};
+
+/****************************************************
+ * static variable
+ ****************************************************/
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief mark ring orphan when owner thread exit
+ * @param data - ring handle
+ */
+static void ring_orphan(void *data)
+{
+    T_ASSERT(NULL != data);
+    async_ring *ring = (async_ring *)data;
+    __atomic_store_n(&ring->orphan, TRUE, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief new ring
+ * @param size - ring buffer size, must be power of 2
+ * @return ring handle
+ */
+static async_ring *ring_new(tuint32 size)
+{
+    async_ring *ring = NULL;
+    if (0 != posix_memalign((void **)&ring, ASYNC_CACHE_LINE, sizeof(async_ring)))
+    {
+        return NULL;
+    }
+
+    ring->buf = malloc(size);
+    if (NULL == ring->buf)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    ring->tail = 0;
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->reserved_head = 0;
+    ring->reserved = NULL;
+    ring->orphan = FALSE;
+    ring->size = size;
+    t_list_init_node(&ring->node);
+
+    return ring;
+}
+
+/**
+ * @brief free ring
+ * @param ring - ring handle
+ */
+static void ring_free(async_ring *ring)
+{
+    T_ASSERT(NULL != ring);
+    free(ring->buf);
+    free(ring);
+}
+
+/**
+ * @brief get ring of current thread, create it if not exist
+ * @param logger - async logger handle
+ * @return ring handle
+ */
+static async_ring *get_ring(async_logger *logger)
+{
+    async_ring *ring = pthread_getspecific(logger->key);
+    if (T_LIKELY(NULL != ring))
+    {
+        return ring;
+    }
+
+    ring = ring_new(logger->ring_size);
+    if (NULL != ring)
+    {
+        if (0 != pthread_setspecific(logger->key, ring))
+        {
+            ring_free(ring);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&logger->mutex);
+        t_list_append(&logger->rings, &ring->node);
+        pthread_mutex_unlock(&logger->mutex);
+    }
+
+    return ring;
+}
+
+/**
+ * @brief wake up writer thread if it is sleeping
+ * @param logger - async logger handle
+ */
+static void wake_writer(async_logger *logger)
+{
+    if (__atomic_load_n(&logger->sleeping, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&logger->mutex);
+        pthread_cond_signal(&logger->cond);
+        pthread_mutex_unlock(&logger->mutex);
+    }
+}
+
+/**
+ * @brief wait until ring has enough free space
+ * @param logger - async logger handle
+ * @param ring - ring handle
+ * @param need - space needed
+ */
+static void ring_reserve(async_logger *logger, async_ring *ring, tuint32 need)
+{
+    while (ring->size - (tuint32)(ring->head - ring->tail_cache) < need)
+    {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (ring->size - (tuint32)(ring->head - ring->tail_cache) < need)
+        {
+            /* ring full, let writer drain it */
+            wake_writer(logger);
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief write records to output, large batch is written straight from
+ *        ring with one writev, data buffered in output stream is flushed
+ *        first to keep order, batch smaller than stream buffer is always
+ *        copied so stream issues buffer sized writes, stream is locked
+ *        during whole batch, so file descriptor is not replaced by
+ *        rotation between flush and writev
+ * @param fd - output file handle
+ * @param iov - records
+ * @param count - record count
+ * @param len - total length of records
+ */
+static void write_records(FILE *fd, struct iovec *iov, tuint32 count, tuint32 len)
+{
+    if (0 == count)
+    {
+        return ;
+    }
+
+    flockfile(fd);
+    if ((len >= ASYNC_WRITEV_MIN) && (len >= ASYNC_STREAM_BUFSIZE(fd)))
+    {
+        fflush(fd);
+        tint fileno_fd = fileno(fd);
+        while ((count > 0) && (fileno_fd >= 0))
+        {
+            ssize_t written = writev(fileno_fd, iov, count);
+            if (written < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                break;
+            }
+
+            /* skip written records, partial write is possible on pipe */
+            while ((count > 0) && ((size_t)written >= iov->iov_len))
+            {
+                written -= iov->iov_len;
+                iov ++;
+                count --;
+            }
+            if (count > 0)
+            {
+                iov->iov_base = (tchar *)iov->iov_base + written;
+                iov->iov_len -= written;
+            }
+        }
+    }
+
+    /* small batch, or writev not available on this stream */
+    for (tuint32 i = 0; i < count; ++i)
+    {
+        fwrite(iov[i].iov_base, 1, iov[i].iov_len, fd);
+    }
+    funlockfile(fd);
+}
+
+/**
+ * @brief write all records in ring to output, adjacent records of
+ *        same output are written by one writev without copy
+ * @param ring - ring handle
+ * @return drained bytes
+ */
+static tuint32 ring_drain(async_ring *ring)
+{
+    tuint64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    tuint64 tail = ring->tail;
+    tuint32 mask = ring->size - 1;
+    async_record *record = NULL;
+    struct iovec iov[ASYNC_IOV_MAX];
+    tuint32 count = 0;
+    tuint32 len = 0;
+    FILE *fd = NULL;
+
+    while (tail != head)
+    {
+        record = (async_record *)(ring->buf + (tail & mask));
+        if (ASYNC_RECORD_DATA == record->type)
+        {
+            if ((fd != record->target.fd) || (ASYNC_IOV_MAX == count))
+            {
+                write_records(fd, iov, count, len);
+                count = 0;
+                len = 0;
+                fd = record->target.fd;
+            }
+            iov[count].iov_base = record + 1;
+            iov[count].iov_len = record->len;
+            count ++;
+            len += record->len;
+        }
+        else if (ASYNC_RECORD_DEFERRED == record->type)
+        {
+            write_records(fd, iov, count, len);
+            count = 0;
+            len = 0;
+            record->target.func((const tchar *)(record + 1), record->len);
+        }
+        else if (ASYNC_RECORD_FLUSH == record->type)
+        {
+            write_records(fd, iov, count, len);
+            count = 0;
+            len = 0;
+            fflush(record->target.fd);
+        }
+        tail += ASYNC_ALIGN_UP(sizeof(async_record) + record->len);
+    }
+    write_records(fd, iov, count, len);
+
+    tuint32 drained = (tuint32)(tail - ring->tail);
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    return drained;
+}
+
+/**
+ * @brief copy ring list, so rings are drained without holding lock and
+ *        new logging threads never wait for output, rings are only
+ *        removed by writer thread, copied rings stay valid
+ * @param logger - async logger handle
+ * @return copied ring count, rings not fit in copy are drained next time
+ */
+static tuint32 copy_rings(async_logger *logger)
+{
+    tuint32 count = 0;
+    tlist *pos = NULL;
+
+    pthread_mutex_lock(&logger->mutex);
+    t_list_foreach(pos, &logger->rings)
+    {
+        if (count == logger->drain_size)
+        {
+            tuint32 size = (0 == logger->drain_size) ? 16 : logger->drain_size << 1;
+            async_ring **rings = realloc(logger->drain_rings, size * sizeof(async_ring *));
+            if (NULL == rings)
+            {
+                break;
+            }
+            logger->drain_rings = rings;
+            logger->drain_size = size;
+        }
+        logger->drain_rings[count++] = t_list_entry(pos, async_ring, node);
+    }
+    pthread_mutex_unlock(&logger->mutex);
+
+    return count;
+}
+
+/**
+ * @brief writer thread, drain all rings to output
+ * @param arg - async logger handle
+ */
+static void *async_writer(void *arg)
+{
+    async_logger *logger = (async_logger *)arg;
+    async_ring *ring = NULL;
+
+    while (1)
+    {
+        tbool running = __atomic_load_n(&logger->running, __ATOMIC_ACQUIRE);
+        tuint32 drained = 0;
+
+        tuint32 count = copy_rings(logger);
+        for (tuint32 i = 0; i < count; ++i)
+        {
+            ring = logger->drain_rings[i];
+            tbool orphan = __atomic_load_n(&ring->orphan, __ATOMIC_ACQUIRE);
+            drained += ring_drain(ring);
+            if (orphan)
+            {
+                /* owner thread exited, nothing will be pushed anymore */
+                pthread_mutex_lock(&logger->mutex);
+                t_list_remove(&ring->node);
+                pthread_mutex_unlock(&logger->mutex);
+                ring_free(ring);
+            }
+        }
+
+        if (0 == drained)
+        {
+            if (!running)
+            {
+                /* all records written */
+                break;
+            }
+
+            /* wait for new records */
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += ASYNC_IDLE_WAIT_NS;
+            if (ts.tv_nsec >= 1000000000)
+            {
+                ts.tv_sec ++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_mutex_lock(&logger->mutex);
+            __atomic_store_n(&logger->sleeping, TRUE, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&logger->running, __ATOMIC_ACQUIRE))
+            {
+                pthread_cond_timedwait(&logger->cond, &logger->mutex, &ts);
+            }
+            __atomic_store_n(&logger->sleeping, FALSE, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&logger->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief new async logger and start writer thread
+ * @param ring_size - per thread ring buffer size
+ * @return async logger handle
+ */
+async_logger *async_new(tuint32 ring_size)
+{
+    T_ASSERT(sizeof(async_record) <= ASYNC_ALIGN);
+
+    async_logger *logger = malloc(sizeof(async_logger));
+    if (NULL == logger)
+    {
+        return NULL;
+    }
+
+    /* ring size must be power of 2 */
+    logger->ring_size = ASYNC_RING_MIN_SIZE;
+    while ((logger->ring_size < ring_size) && (logger->ring_size < 0x80000000))
+    {
+        logger->ring_size <<= 1;
+    }
+
+    t_list_init_head(&logger->rings);
+    logger->running = TRUE;
+    logger->sleeping = FALSE;
+    logger->drain_rings = NULL;
+    logger->drain_size = 0;
+
+    if (0 != pthread_key_create(&logger->key, ring_orphan))
+    {
+        free(logger);
+        return NULL;
+    }
+
+    pthread_mutex_init(&logger->mutex, NULL);
+    pthread_cond_init(&logger->cond, NULL);
+
+    if (0 != pthread_create(&logger->writer, NULL, async_writer, logger))
+    {
+        pthread_cond_destroy(&logger->cond);
+        pthread_mutex_destroy(&logger->mutex);
+        pthread_key_delete(logger->key);
+        free(logger);
+        return NULL;
+    }
+
+    return logger;
+}
+
+/**
+ * @brief stop writer thread and free async logger,
+ *        all pushed records are written before return
+ * @param logger - async logger handle
+ */
+void async_free(async_logger *logger)
+{
+    T_ASSERT(NULL != logger);
+
+    pthread_mutex_lock(&logger->mutex);
+    __atomic_store_n(&logger->running, FALSE, __ATOMIC_RELEASE);
+    pthread_cond_signal(&logger->cond);
+    pthread_mutex_unlock(&logger->mutex);
+    pthread_join(logger->writer, NULL);
+
+    pthread_key_delete(logger->key);
+
+    tlist *pos = NULL, *next = NULL;
+    for (pos = logger->rings.next; pos != &logger->rings; pos = next)
+    {
+        next = pos->next;
+        ring_free(t_list_entry(pos, async_ring, node));
+    }
+    free(logger->drain_rings);
+
+    pthread_cond_destroy(&logger->cond);
+    pthread_mutex_destroy(&logger->mutex);
+    free(logger);
+}
+
+/**
+ * @brief reserve record space in ring
+ * @param logger - async logger handle
+ * @param ring - ring handle
+ * @param len - record payload length
+ * @return record header, NULL means record is too large for ring,
+ *         and all queued records of ring have been written
+ */
+static async_record *ring_reserve_record(async_logger *logger,
+        async_ring *ring, tuint32 len)
+{
+    tuint32 need = ASYNC_ALIGN_UP(sizeof(async_record) + len);
+    if (T_UNLIKELY(need > ring->size / 2))
+    {
+        /* too large for ring, wait for all queued records written */
+        ring_reserve(logger, ring, ring->size);
+        return NULL;
+    }
+
+    tuint32 offset = ring->head & (ring->size - 1);
+    tuint32 to_end = ring->size - offset;
+    tuint64 head = ring->head;
+    async_record *record = NULL;
+    if (need > to_end)
+    {
+        /* no enough space at the end, skip to the begin of ring */
+        ring_reserve(logger, ring, to_end + need);
+        record = (async_record *)(ring->buf + offset);
+        record->len = to_end - sizeof(async_record);
+        record->type = ASYNC_RECORD_WRAP;
+        record->target.fd = NULL;
+        head += to_end;
+        offset = 0;
+    }
+    else
+    {
+        ring_reserve(logger, ring, need);
+    }
+
+    record = (async_record *)(ring->buf + offset);
+    record->len = len;
+    ring->reserved_head = head + need;
+    ring->reserved = record;
+
+    return record;
+}
+
+/**
+ * @brief publish reserved record to writer thread
+ * @param logger - async logger handle
+ * @param ring - ring handle
+ */
+static void ring_commit_record(async_logger *logger, async_ring *ring)
+{
+    T_ASSERT(NULL != ring->reserved);
+    ring->reserved = NULL;
+    __atomic_store_n(&ring->head, ring->reserved_head, __ATOMIC_RELEASE);
+    wake_writer(logger);
+}
+
+/**
+ * @brief push log data to current thread ring, the data
+ *        will be written to fd by writer thread
+ * @param logger - async logger handle
+ * @param fd - output file handle
+ * @param data - log data
+ * @param len - log data length
+ */
+void async_push(async_logger *logger, FILE *fd, const tchar *data, tuint32 len)
+{
+    T_ASSERT(NULL != logger);
+    T_ASSERT(NULL != fd);
+    T_ASSERT(NULL != data);
+
+    async_ring *ring = get_ring(logger);
+    if (T_UNLIKELY(NULL == ring))
+    {
+        /* no memory for ring, write directly */
+        fwrite(data, 1, len, fd);
+        return ;
+    }
+
+    async_record *record = ring_reserve_record(logger, ring, len);
+    if (NULL == record)
+    {
+        fwrite(data, 1, len, fd);
+        return ;
+    }
+
+    record->type = ASYNC_RECORD_DATA;
+    record->target.fd = fd;
+    memcpy(record + 1, data, len);
+    ring_commit_record(logger, ring);
+}
+
+/**
+ * @brief push flush mark to current thread ring, fd is flushed by
+ *        writer thread after all records pushed before are written
+ * @param logger - async logger handle
+ * @param fd - output file handle
+ */
+void async_flush(async_logger *logger, FILE *fd)
+{
+    T_ASSERT(NULL != logger);
+    T_ASSERT(NULL != fd);
+
+    async_ring *ring = get_ring(logger);
+    if (T_UNLIKELY(NULL == ring))
+    {
+        fflush(fd);
+        return ;
+    }
+
+    async_record *record = ring_reserve_record(logger, ring, 0);
+    if (NULL == record)
+    {
+        fflush(fd);
+        return ;
+    }
+
+    record->type = ASYNC_RECORD_FLUSH;
+    record->target.fd = fd;
+    ring_commit_record(logger, ring);
+}
+
+/**
+ * @brief reserve deferred record space in current thread ring,
+ *        fill it and call async_commit() to publish it
+ * @param logger - async logger handle
+ * @param len - record length
+ * @return record buffer, 8 bytes aligned, NULL means record
+ *         can not be queued and all queued records of current
+ *         thread have been written
+ */
+tchar *async_reserve(async_logger *logger, tuint32 len)
+{
+    T_ASSERT(NULL != logger);
+
+    async_ring *ring = get_ring(logger);
+    if (T_UNLIKELY(NULL == ring))
+    {
+        return NULL;
+    }
+
+    async_record *record = ring_reserve_record(logger, ring, len);
+    if (NULL == record)
+    {
+        return NULL;
+    }
+
+    return (tchar *)(record + 1);
+}
+
+/**
+ * @brief publish record reserved by async_reserve()
+ * @param logger - async logger handle
+ * @param func - record write function, called in writer thread
+ */
+void async_commit(async_logger *logger, async_write_func func)
+{
+    T_ASSERT(NULL != logger);
+    T_ASSERT(NULL != func);
+
+    async_ring *ring = pthread_getspecific(logger->key);
+    T_ASSERT(NULL != ring);
+    ring->reserved->type = ASYNC_RECORD_DEFERRED;
+    ring->reserved->target.func = func;
+    ring_commit_record(logger, ring);
+}
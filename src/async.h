@@ -0,0 +1,32 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _ASYNC_H_
+#define _ASYNC_H_
+
+#include <stdio.h>
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+typedef struct _async_logger async_logger;
+
+/* deferred record write function, called in writer thread */
+typedef void (*async_write_func)(const tchar *data, tuint32 len);
+
+/* async interface */
+T_EXTERN async_logger *async_new(tuint32 ring_size);
+T_EXTERN void async_free(async_logger *logger);
+T_EXTERN void async_push(async_logger *logger, FILE *fd,
+        const tchar *data, tuint32 len);
+T_EXTERN void async_flush(async_logger *logger, FILE *fd);
+T_EXTERN tchar *async_reserve(async_logger *logger, tuint32 len);
+T_EXTERN void async_commit(async_logger *logger, async_write_func func);
+
+T_END_DECLS
+
+#endif /* _ASYNC_H_ */
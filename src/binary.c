@@ -0,0 +1,858 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "tassert.h"
+#include "argpack.h"
+#include "binary.h"
+#include "level.h"
+#include "tstring.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+#define BINARY_MAGIC        "TLOGBIN"
+#define BINARY_MAGIC_LEN    7
+#define BINARY_VERSION      1
+/* initial call site table size, must be power of 2 */
+#define SITE_TABLE_SIZE     64
+/* per thread call site id cache size, must be power of 2 */
+#define SITE_CACHE_SIZE     256
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+/*
+ * call site table slot, keyed by call site and format content,
+ * format may be built at runtime, so writer keeps its own copy
+ */
+typedef struct
+{
+    const tlog_callsite *site;
+    tchar *fmt;
+    tuint64 hash;
+    tuint32 id;
+}site_slot;
+
+/* per thread call site id cache slot, keyed by writer and call site */
+typedef struct
+{
+    /* writer serial, 0 means empty slot */
+    tuint64 serial;
+    const tlog_callsite *site;
+    /* format copy owned by writer */
+    const tchar *fmt;
+    tuint32 id;
+}site_cache_slot;
+
+struct _binary_writer
+{
+    /* unique in process, freed writer address may be reused */
+    tuint64 serial;
+    pthread_mutex_t mutex;
+    site_slot *table;
+    tuint32 size;
+    tuint32 count;
+};
+
+/* parsed binary entry */
+typedef struct
+{
+    tchar type;
+    tuint32 id;
+    /* header */
+    tuint32 pid;
+    const tchar *format;
+    /* call site */
+    tuint32 level;
+    tint64 line;
+    const tchar *file;
+    const tchar *func;
+    const tchar *fmt;
+    /* record */
+    tint64 sec;
+    tint64 nsec;
+    tuint64 tid;
+    const tchar *payload;
+    tuint32 payload_len;
+}binary_entry;
+
+/* decoded call site */
+typedef struct
+{
+    tbool valid;
+    tlog_callsite site;
+    const tchar *fmt;
+    tchar line_str[24];
+}decode_site;
+
+/****************************************************
+ * static variable
+ ****************************************************/
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static tuint64 writer_serial = 0;
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief create binary writer
+ * @return binary writer handle, NULL means no memory
+ */
+binary_writer *binary_new(void)
+{
+    binary_writer *writer = malloc(sizeof(binary_writer));
+    if (NULL == writer)
+    {
+        return NULL;
+    }
+
+    writer->table = calloc(SITE_TABLE_SIZE, sizeof(site_slot));
+    if (NULL == writer->table)
+    {
+        free(writer);
+        return NULL;
+    }
+    writer->serial = __atomic_add_fetch(&writer_serial, 1, __ATOMIC_RELAXED);
+    writer->size = SITE_TABLE_SIZE;
+    writer->count = 0;
+    pthread_mutex_init(&writer->mutex, NULL);
+
+    return writer;
+}
+
+/**
+ * @brief free binary writer
+ * @param writer - binary writer handle
+ */
+void binary_free(binary_writer *writer)
+{
+    T_ASSERT(NULL != writer);
+    pthread_mutex_destroy(&writer->mutex);
+    for (tuint32 i = 0; i < writer->size; ++i)
+    {
+        free(writer->table[i].fmt);
+    }
+    free(writer->table);
+    free(writer);
+}
+
+/**
+ * @brief create call site id cache key
+ */
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, free);
+}
+
+/**
+ * @brief get call site id cache of current thread
+ * @return call site id cache, NULL means no memory
+ */
+static site_cache_slot *get_cache(void)
+{
+    pthread_once(&cache_once, cache_key_create);
+    site_cache_slot *cache = pthread_getspecific(cache_key);
+    if (NULL == cache)
+    {
+        cache = calloc(SITE_CACHE_SIZE, sizeof(site_cache_slot));
+        if (NULL == cache)
+        {
+            return NULL;
+        }
+        if (0 != pthread_setspecific(cache_key, cache))
+        {
+            free(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+/**
+ * @brief hash call site and format content
+ * @param site - call site
+ * @param fmt - user message format
+ * @return hash value
+ */
+static tuint64 site_hash(const tlog_callsite *site, const tchar *fmt)
+{
+    /* fnv-1a */
+    tuint64 hash = 0xcbf29ce484222325ULL ^ ((uintptr_t)site >> 3);
+    for (; '\0' != *fmt; ++fmt)
+    {
+        hash = (hash ^ (tuint8)*fmt) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief get call site slot index in table
+ * @param table - call site table
+ * @param size - table size
+ * @param site - call site
+ * @param fmt - user message format
+ * @param hash - hash of call site and format
+ * @return slot index, empty slot if not found
+ */
+static tuint32 site_slot_index(const site_slot *table, tuint32 size,
+        const tlog_callsite *site, const tchar *fmt, tuint64 hash)
+{
+    tuint32 index = (tuint32)((hash * 0x9e3779b97f4a7c15ULL) >> 32) & (size - 1);
+    while (NULL != table[index].site)
+    {
+        if ((hash == table[index].hash) && (site == table[index].site) &&
+            (0 == strcmp(fmt, table[index].fmt)))
+        {
+            break;
+        }
+        index = (index + 1) & (size - 1);
+    }
+
+    return index;
+}
+
+/**
+ * @brief double call site table size, called with mutex locked
+ * @param writer - binary writer handle
+ * @return error code, 0 means no error
+ */
+static tint site_table_grow(binary_writer *writer)
+{
+    tuint32 size = writer->size << 1;
+    site_slot *table = calloc(size, sizeof(site_slot));
+    if (NULL == table)
+    {
+        return -ENOMEM;
+    }
+
+    for (tuint32 i = 0; i < writer->size; ++i)
+    {
+        if (NULL != writer->table[i].site)
+        {
+            tuint32 index = site_slot_index(table, size, writer->table[i].site,
+                    writer->table[i].fmt, writer->table[i].hash);
+            table[index] = writer->table[i];
+        }
+    }
+
+    free(writer->table);
+    writer->table = table;
+    writer->size = size;
+
+    return 0;
+}
+
+/**
+ * @brief get call site id, assign new one if not exist, ids known
+ *        by current thread are got from cache without locking
+ * @param writer - binary writer handle
+ * @param site - call site
+ * @param fmt - user message format
+ * @param id - call site id output
+ * @return 1: new call site, 0: exist, < 0: error
+ */
+static tint site_get_id(binary_writer *writer, const tlog_callsite *site,
+        const tchar *fmt, tuint32 *id)
+{
+    if (NULL == fmt)
+    {
+        fmt = "";
+    }
+
+    /* call site almost always has one format, compare content to be sure */
+    site_cache_slot *cache = get_cache();
+    site_cache_slot *slot = NULL;
+    if (NULL != cache)
+    {
+        tuint64 hash = ((uintptr_t)site >> 3) ^ writer->serial;
+        slot = &cache[((hash * 0x9e3779b97f4a7c15ULL) >> 32) & (SITE_CACHE_SIZE - 1)];
+        if ((writer->serial == slot->serial) && (site == slot->site) &&
+            (0 == strcmp(fmt, slot->fmt)))
+        {
+            *id = slot->id;
+            return 0;
+        }
+    }
+
+    tint ret = 0;
+    tuint64 hash = site_hash(site, fmt);
+    pthread_mutex_lock(&writer->mutex);
+    tuint32 index = site_slot_index(writer->table, writer->size, site, fmt, hash);
+    if (NULL == writer->table[index].site)
+    {
+        if ((writer->count + 1) * 2 > writer->size)
+        {
+            ret = site_table_grow(writer);
+            if (0 != ret)
+            {
+                pthread_mutex_unlock(&writer->mutex);
+                return ret;
+            }
+            index = site_slot_index(writer->table, writer->size, site, fmt, hash);
+        }
+        tchar *copy = malloc(strlen(fmt) + 1);
+        if (NULL == copy)
+        {
+            pthread_mutex_unlock(&writer->mutex);
+            return -ENOMEM;
+        }
+        strcpy(copy, fmt);
+        writer->table[index].site = site;
+        writer->table[index].fmt = copy;
+        writer->table[index].hash = hash;
+        writer->table[index].id = writer->count++;
+        ret = 1;
+    }
+    *id = writer->table[index].id;
+    const tchar *fmt_copy = writer->table[index].fmt;
+    pthread_mutex_unlock(&writer->mutex);
+
+    if (NULL != slot)
+    {
+        slot->serial = writer->serial;
+        slot->site = site;
+        slot->fmt = fmt_copy;
+        slot->id = *id;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief append 32 bits integer
+ * @param buf - output buffer
+ * @param value - value
+ * @return error code, 0 means no error
+ */
+static tint put_u32(tbuffer *buf, tuint32 value)
+{
+    return t_buffer_append(buf, (const tchar *)&value, sizeof(value));
+}
+
+/**
+ * @brief append 64 bits integer
+ * @param buf - output buffer
+ * @param value - value
+ * @return error code, 0 means no error
+ */
+static tint put_u64(tbuffer *buf, tuint64 value)
+{
+    return t_buffer_append(buf, (const tchar *)&value, sizeof(value));
+}
+
+/**
+ * @brief append string, length includes '\0'
+ * @param buf - output buffer
+ * @param str - string, NULL means empty
+ * @return error code, 0 means no error
+ */
+static tint put_string(tbuffer *buf, const tchar *str)
+{
+    if (NULL == str)
+    {
+        str = "";
+    }
+
+    tuint32 len = strlen(str) + 1;
+    if (0 != put_u32(buf, len))
+    {
+        return -ENOMEM;
+    }
+
+    return t_buffer_append(buf, str, len);
+}
+
+/**
+ * @brief append file header entry
+ * @param buf - output buffer
+ * @param format - rule format string
+ * @return error code, 0 means no error
+ */
+tint binary_write_header(tbuffer *buf, const tchar *format)
+{
+    T_ASSERT(NULL != buf);
+    T_ASSERT(NULL != format);
+
+    if ((0 != t_buffer_append_char(buf, 'H', 1)) ||
+        (0 != t_buffer_append(buf, BINARY_MAGIC, BINARY_MAGIC_LEN)) ||
+        (0 != put_u32(buf, BINARY_VERSION)) ||
+        (0 != put_u32(buf, (tuint32)getpid())) ||
+        (0 != put_string(buf, format)))
+    {
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief append record entry head, length is filled later
+ * @param buf - output buffer
+ * @param type - record type
+ * @param id - call site id
+ * @param pre - preprocess information
+ * @return error code, 0 means no error
+ */
+static tint put_record_head(tbuffer *buf, tchar type, tuint32 id,
+        const preprocess_info *pre)
+{
+    const thread_identity *ident = (NULL != pre->ident) ? pre->ident : identity_current();
+    if (NULL == ident)
+    {
+        return -ENOMEM;
+    }
+
+    if ((0 != t_buffer_append_char(buf, type, 1)) ||
+        (0 != put_u32(buf, id)) ||
+        (0 != put_u64(buf, (tuint64)pre->ts.tv_sec)) ||
+        (0 != put_u64(buf, (tuint64)pre->ts.tv_nsec)) ||
+        (0 != put_u64(buf, (tuint64)ident->tid)) ||
+        (0 != put_u32(buf, 0)))
+    {
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief encode log record, call site is added to dictionary if new
+ * @param writer - binary writer handle
+ * @param buf - output buffer
+ * @param pre - preprocess information
+ * @return error code, 0 means no error
+ */
+tint binary_encode(binary_writer *writer, tbuffer *buf, const preprocess_info *pre)
+{
+    T_ASSERT(NULL != writer);
+    T_ASSERT(NULL != buf);
+    T_ASSERT(NULL != pre);
+
+    tuint32 id = 0;
+    tint ret = site_get_id(writer, pre->site, pre->fmt, &id);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (1 == ret)
+    {
+        /* dictionary entry */
+        if ((0 != t_buffer_append_char(buf, 'S', 1)) ||
+            (0 != put_u32(buf, id)) ||
+            (0 != put_u32(buf, pre->site->level)) ||
+            (0 != put_u64(buf, (tuint64)pre->site->line)) ||
+            (0 != put_string(buf, pre->site->file)) ||
+            (0 != put_string(buf, pre->site->func)) ||
+            (0 != put_string(buf, pre->fmt)))
+        {
+            return -ENOMEM;
+        }
+    }
+
+    /* packed arguments if possible, otherwise rendered message */
+    tint pack_len = -1;
+    const tchar *packed = pre->packed;
+    if (NULL != packed)
+    {
+        pack_len = pre->packed_len;
+    }
+    else if (NULL != pre->args)
+    {
+        va_list args;
+        va_copy(args, *pre->args);
+        pack_len = argpack_size(pre->fmt, args);
+        va_end(args);
+    }
+
+    tuint32 start = buf->len;
+    if (0 != put_record_head(buf, (pack_len >= 0) ? 'R' : 'T', id, pre))
+    {
+        return -ENOMEM;
+    }
+    tuint32 len_pos = buf->len - sizeof(tuint32);
+
+    if (NULL != packed)
+    {
+        ret = t_buffer_append(buf, packed, pack_len);
+    }
+    else if (pack_len >= 0)
+    {
+        ret = t_buffer_reserve(buf, pack_len);
+        if (0 == ret)
+        {
+            va_list args;
+            va_copy(args, *pre->args);
+            argpack_pack(buf->data + buf->len, pre->fmt, args);
+            va_end(args);
+            buf->len += pack_len;
+        }
+    }
+    else
+    {
+        if (NULL != pre->args)
+        {
+            ret = t_buffer_vprintf(buf, pre->fmt, *pre->args);
+        }
+        else if (NULL != pre->user_msg)
+        {
+            ret = t_buffer_append(buf, pre->user_msg, strlen(pre->user_msg));
+        }
+
+        if (0 == ret)
+        {
+            ret = t_buffer_append_char(buf, '\0', 1);
+        }
+    }
+
+    if (0 != ret)
+    {
+        buf->len = start;
+        return ret;
+    }
+
+    tuint32 payload_len = buf->len - len_pos - sizeof(tuint32);
+    memcpy(buf->data + len_pos, &payload_len, sizeof(payload_len));
+
+    return 0;
+}
+
+/**
+ * @brief read 32 bits integer
+ * @param data - data
+ * @param len - data length
+ * @param pos - read position, moved after value
+ * @param value - value output
+ * @return TRUE: success
+ */
+static tbool get_u32(const tchar *data, tuint32 len, tuint32 *pos, tuint32 *value)
+{
+    if (len - *pos < sizeof(tuint32))
+    {
+        return FALSE;
+    }
+    memcpy(value, data + *pos, sizeof(tuint32));
+    *pos += sizeof(tuint32);
+    return TRUE;
+}
+
+/**
+ * @brief read 64 bits integer
+ * @param data - data
+ * @param len - data length
+ * @param pos - read position, moved after value
+ * @param value - value output
+ * @return TRUE: success
+ */
+static tbool get_u64(const tchar *data, tuint32 len, tuint32 *pos, tuint64 *value)
+{
+    if (len - *pos < sizeof(tuint64))
+    {
+        return FALSE;
+    }
+    memcpy(value, data + *pos, sizeof(tuint64));
+    *pos += sizeof(tuint64);
+    return TRUE;
+}
+
+/**
+ * @brief read string, must be '\0' terminated
+ * @param data - data
+ * @param len - data length
+ * @param pos - read position, moved after string
+ * @param str - string output
+ * @return TRUE: success
+ */
+static tbool get_string(const tchar *data, tuint32 len, tuint32 *pos, const tchar **str)
+{
+    tuint32 str_len = 0;
+    if ((!get_u32(data, len, pos, &str_len)) || (0 == str_len) ||
+        (len - *pos < str_len) || ('\0' != data[*pos + str_len - 1]))
+    {
+        return FALSE;
+    }
+    *str = data + *pos;
+    *pos += str_len;
+    return TRUE;
+}
+
+/**
+ * @brief parse one entry
+ * @param data - data
+ * @param len - data length
+ * @param pos - entry position, moved to next entry
+ * @param entry - entry output
+ * @return TRUE: success
+ */
+static tbool parse_entry(const tchar *data, tuint32 len, tuint32 *pos, binary_entry *entry)
+{
+    tuint32 value = 0;
+    tuint64 value64 = 0;
+
+    if (*pos >= len)
+    {
+        return FALSE;
+    }
+
+    entry->type = data[(*pos)++];
+    switch (entry->type)
+    {
+    case 'H':
+        if ((len - *pos < BINARY_MAGIC_LEN) ||
+            (0 != memcmp(data + *pos, BINARY_MAGIC, BINARY_MAGIC_LEN)))
+        {
+            return FALSE;
+        }
+        *pos += BINARY_MAGIC_LEN;
+        return get_u32(data, len, pos, &value) && (BINARY_VERSION == value) &&
+            get_u32(data, len, pos, &entry->pid) &&
+            get_string(data, len, pos, &entry->format);
+    case 'S':
+        if (!(get_u32(data, len, pos, &entry->id) &&
+              get_u32(data, len, pos, &entry->level) &&
+              get_u64(data, len, pos, &value64) &&
+              get_string(data, len, pos, &entry->file) &&
+              get_string(data, len, pos, &entry->func) &&
+              get_string(data, len, pos, &entry->fmt)))
+        {
+            return FALSE;
+        }
+        /* level indexes level name tables when rendered */
+        if (((entry->level & LEVEL_INDEX_MASK) >= 6) ||
+            (0 != (entry->level & ~(LEVEL_MASK | LEVEL_INDEX_MASK))))
+        {
+            return FALSE;
+        }
+        entry->line = (tint64)value64;
+        return TRUE;
+    case 'R':
+    case 'T':
+        if (!(get_u32(data, len, pos, &entry->id) &&
+              get_u64(data, len, pos, &value64)))
+        {
+            return FALSE;
+        }
+        entry->sec = (tint64)value64;
+        if (!get_u64(data, len, pos, &value64))
+        {
+            return FALSE;
+        }
+        entry->nsec = (tint64)value64;
+        if (!(get_u64(data, len, pos, &entry->tid) &&
+              get_u32(data, len, pos, &entry->payload_len)) ||
+            (len - *pos < entry->payload_len))
+        {
+            return FALSE;
+        }
+        entry->payload = data + *pos;
+        *pos += entry->payload_len;
+        if (('T' == entry->type) &&
+            ((0 == entry->payload_len) ||
+             ('\0' != entry->payload[entry->payload_len - 1])))
+        {
+            return FALSE;
+        }
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/**
+ * @brief collect call sites of one segment, ids are assigned from 0
+ *        and written once per file, so they are less than entry count
+ * @param data - data
+ * @param start - segment start position
+ * @param end - segment end position
+ * @param sites - call site array output
+ * @param count - call site count
+ * @return error code, 0 means no error, -EINVAL means some call
+ *         sites are corrupted and skipped
+ */
+static tint collect_sites(const tchar *data, tuint32 start, tuint32 end,
+        decode_site **sites, tuint32 *count)
+{
+    tint err = 0;
+    binary_entry entry;
+    tuint32 pos = start;
+    *count = 0;
+    while ((pos < end) && parse_entry(data, end, &pos, &entry))
+    {
+        if ('S' == entry.type)
+        {
+            (*count)++;
+        }
+    }
+
+    *sites = calloc(MAX(*count, 1), sizeof(decode_site));
+    if (NULL == *sites)
+    {
+        return -ENOMEM;
+    }
+
+    pos = start;
+    while ((pos < end) && parse_entry(data, end, &pos, &entry))
+    {
+        if ('S' != entry.type)
+        {
+            continue;
+        }
+
+        if (entry.id >= *count)
+        {
+            err = -EINVAL;
+            continue;
+        }
+
+        decode_site *site = &(*sites)[entry.id];
+        site->valid = TRUE;
+        site->fmt = entry.fmt;
+        /* empty file name means not provided */
+        site->site.file = ('\0' != entry.file[0]) ? entry.file : NULL;
+        site->site.filename = NULL;
+        site->site.func = entry.func;
+        site->site.line = (long)entry.line;
+        site->site.level = (int)entry.level;
+        t_string_from_int(site->line_str, site->site.line);
+        site->site.line_str = site->line_str;
+    }
+
+    return err;
+}
+
+/**
+ * @brief decode binary log to text
+ * @param data - binary log data
+ * @param len - data length
+ * @param out - text output buffer, decoded text is appended
+ * @return error code, 0 means no error
+ */
+tint binary_decode(const tchar *data, tuint32 len, tbuffer *out)
+{
+    T_ASSERT(NULL != data);
+    T_ASSERT(NULL != out);
+
+    tint err = 0;
+    tuint32 pos = 0;
+    binary_entry entry;
+    tbuffer msg_buf;
+    t_buffer_init(&msg_buf);
+
+    while ((0 == err) && (pos < len))
+    {
+        /* every segment starts with a header */
+        if (!parse_entry(data, len, &pos, &entry) || ('H' != entry.type))
+        {
+            err = -EINVAL;
+            break;
+        }
+
+        split_format *splits = format_to_split(entry.format);
+        if (NULL == splits)
+        {
+            err = -EINVAL;
+            break;
+        }
+        tuint32 pid = entry.pid;
+
+        /* find segment end */
+        tuint32 start = pos;
+        tuint32 end = pos;
+        tuint32 next = pos;
+        while (parse_entry(data, len, &next, &entry) && ('H' != entry.type))
+        {
+            end = next;
+        }
+        if ((end < len) && (('H' != data[end]) || (next <= end)))
+        {
+            /* truncated or corrupted tail */
+            err = -EINVAL;
+        }
+
+        /* call sites may be written after records of other threads */
+        decode_site *sites = NULL;
+        tuint32 site_count = 0;
+        tint ret = collect_sites(data, start, end, &sites, &site_count);
+        if (-ENOMEM != ret)
+        {
+            if (0 != ret)
+            {
+                err = ret;
+            }
+
+            /* kernel thread id and thread name are not recorded */
+            thread_identity ident;
+            identity_init(&ident, 0, 0, pid, NULL);
+            preprocess_info pre;
+            memset(&pre, 0, sizeof(pre));
+            pre.ident = &ident;
+            pre.msg_buf = &msg_buf;
+
+            pos = start;
+            while ((pos < end) && parse_entry(data, end, &pos, &entry))
+            {
+                if (('R' != entry.type) && ('T' != entry.type))
+                {
+                    continue;
+                }
+
+                /* skip record with unknown call site or mismatched arguments */
+                if ((entry.id >= site_count) || (!sites[entry.id].valid) ||
+                    (('R' == entry.type) &&
+                     (argpack_render(NULL, 0, sites[entry.id].fmt, entry.payload,
+                                     entry.payload_len) < 0)))
+                {
+                    err = -EINVAL;
+                    continue;
+                }
+
+                pre.site = &sites[entry.id].site;
+                pre.fmt = sites[entry.id].fmt;
+                pre.user_msg = NULL;
+                pre.packed = NULL;
+                pre.packed_len = 0;
+                if ('R' == entry.type)
+                {
+                    pre.packed = entry.payload;
+                    pre.packed_len = entry.payload_len;
+                }
+                else
+                {
+                    pre.user_msg = entry.payload;
+                }
+                pre.ts.tv_sec = (time_t)entry.sec;
+                pre.ts.tv_nsec = (long)entry.nsec;
+                if (!pthread_equal(ident.tid, (pthread_t)entry.tid))
+                {
+                    identity_init(&ident, (pthread_t)entry.tid, 0, pid, NULL);
+                }
+                format_split_to_string(out, splits, &pre);
+            }
+        }
+        else
+        {
+            err = -ENOMEM;
+        }
+
+        free(sites);
+        split_format_free(splits);
+        pos = end;
+    }
+
+    t_buffer_free(&msg_buf);
+    return err;
+}
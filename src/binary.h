@@ -0,0 +1,35 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include "ttypes.h"
+#include "tbuffer.h"
+#include "format.h"
+
+T_BEGIN_DECLS
+
+typedef struct _binary_writer binary_writer;
+
+/*
+ * binary log entries, integers are in host byte order
+ * 'H': file header, magic, version, pid, rule format
+ * 'S': call site dictionary, written once per site and file
+ * 'R': record, site id, time(sec, nsec), thread id, packed arguments
+ * 'T': record, site id, time(sec, nsec), thread id, rendered message
+ */
+T_EXTERN binary_writer *binary_new(void);
+T_EXTERN void binary_free(binary_writer *writer);
+T_EXTERN tint binary_write_header(tbuffer *buf, const tchar *format);
+T_EXTERN tint binary_encode(binary_writer *writer, tbuffer *buf,
+        const preprocess_info *pre);
+T_EXTERN tint binary_decode(const tchar *data, tuint32 len, tbuffer *out);
+
+T_END_DECLS
+
+#endif /* _BINARY_H_ */
@@ -11,6 +11,9 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "tkeyfile.h"
 #include "thash_string.h"
 #include "tslist.h"
@@ -19,33 +22,120 @@
 #include "global.h"
 #include "level.h"
 #include "format.h"
+#include "argpack.h"
+#include "binary.h"
+#include "timestamp.h"
+#include "flusher.h"
 #include "category.h"
 
 /****************************************************
  * macros definition
  ****************************************************/
+/* file output buffer size, rounded up to page size */
+#define RULE_BUFFER_DEFAULT    4096
+#define RULE_BUFFER_MAX        (64 * 1024 * 1024)
+/* rotated files kept by default */
+#define RULE_MAX_FILES_DEFAULT 5
+/* file name with rotate suffix */
+#define RULE_PATH_MAX          300
+/* never switch to file of new time */
+#define RULE_SWITCH_NEVER      0x7fffffffffffffffLL
+/* boundaries checked to find next file name change */
+#define RULE_SWITCH_TRIES      400
 
 /****************************************************
  * struct definition
  ****************************************************/
+/* finest time unit of output file name */
+typedef enum
+{
+    SWITCH_NONE,
+    SWITCH_DAY,
+    SWITCH_HOUR,
+    SWITCH_MINUTE,
+    SWITCH_SECOND,
+}switch_unit;
+
 /* category detail */
 typedef struct 
 {
     tlog_level level;
     const tchar *format;
     const split_format *splits;
+    /* splits with category name and pid folded into literals */
+    split_format *folded;
+    /* splits with only category name folded, used after fork */
+    split_format *folded_child;
+    /* pid folded into splits */
+    pid_t pid;
     tchar *output;
     FILE* fd;
+    /* binary output writer, NULL means text output */
+    binary_writer *binary;
+    /* library owned stdio buffer of file output, page multiple size */
+    tchar *buffer;
+    tuint32 buffer_size;
+    /* flush after record of these levels, 0 means never */
+    tuint32 flush_level;
+    /* flush when last flush is older than this, 0 means never */
+    tuint32 flush_age_ms;
+    /* last flush time in nanosecond */
+    tuint64 last_flush_ns;
+    /* bytes written since last sync */
+    tuint64 dirty;
+    /* sync again next time, only accessed by flusher thread */
+    tbool sync_again;
+    /* expanded file name, NULL means not file output */
+    tchar *path;
+    /* rotate when file size reaches it, 0 means never */
+    tuint32 max_size;
+    /* rotated files kept, 0 means remove rotated file */
+    tuint32 max_files;
+    /* bytes written to current file */
+    tuint64 size;
+    /* pre-opened next file and its size, -1 means not ready */
+    tint next_fd;
+    tuint64 next_size;
+    /* replaced file waiting for rotating, -1 means none */
+    tint old_fd;
+    /* time unit of file name, SWITCH_NONE means fixed name */
+    switch_unit unit;
+    /* switch to file of new time when log clock reaches it */
+    tint64 switch_sec;
+    /* switch requested, handled by rotate thread */
+    tbool switch_pending;
 }category_rule;
 
 /* category */
 struct _tlog_category
 {
+    /* must be the first member */
+    tlog_category_head head;
     tchar *name;
     tuint32 count;
     category_rule *rules;
+    /* all rules can be formatted in writer thread */
+    tbool deferrable;
 };
 
+/*
+ * deferred log record, packed arguments and format copy follow,
+ * format may be built at runtime and freed before record is written
+ */
+typedef struct
+{
+    const tlog_category *cat;
+    const tlog_callsite *site;
+    tuint32 pack_len;
+    struct timespec ts;
+    struct timespec uptime;
+    /* identity of logging thread */
+    pthread_t tid;
+    pid_t ktid;
+    pid_t pid;
+    tchar name[IDENTITY_NAME_LEN];
+}deferred_record;
+
 /* category node */
 typedef struct
 {
@@ -61,9 +151,29 @@ typedef struct
     tslist node;
 }category_name_node;
 
+/* per thread render buffers, reused by every record */
+typedef struct
+{
+    /* user message with width constraints */
+    tbuffer msg;
+    /* formatted record */
+    tbuffer record;
+    /* identity of last deferred record */
+    tbool ident_valid;
+    thread_identity ident;
+}render_context;
+
 /****************************************************
  * static variable 
  ****************************************************/
+static pthread_once_t render_once = PTHREAD_ONCE_INIT;
+static pthread_key_t render_key;
+/* background file sync, NULL means never sync */
+static flusher *sync_flusher = NULL;
+/* kick flusher when dirty bytes of a rule reach it, 0 means never */
+static tuint32 sync_bytes = 0;
+/* renames rotated files and pre-opens next file */
+static flusher *rotate_flusher = NULL;
 
 /****************************************************
  * functions 
@@ -143,12 +253,38 @@ static tint name_count(void *key, void *value, void *userdata)
     return 0;
 }
 
+/**
+ * @brief release rotate resources of rule, empty pre-opened
+ *        next file is removed
+ * @param cat_rule - category rule
+ */
+static void rule_close_rotate(category_rule *cat_rule)
+{
+    if (-1 != cat_rule->old_fd)
+    {
+        close(cat_rule->old_fd);
+    }
+
+    if (-1 != cat_rule->next_fd)
+    {
+        struct stat st;
+        if ((0 == fstat(cat_rule->next_fd, &st)) && (0 == st.st_size))
+        {
+            tchar name[RULE_PATH_MAX];
+            snprintf(name, sizeof(name), "%s.next", cat_rule->path);
+            unlink(name);
+        }
+        close(cat_rule->next_fd);
+    }
+
+    free(cat_rule->path);
+}
+
 /**
  * @brief free category hash table
  * @param data - category hash node 
- * @param userdata - userdata
  */
-static tint category_free_internal(void *data, void *userdata)
+static void category_free_internal(void *data)
 {
     T_ASSERT(NULL != data);
     thash_string_node *string_node = (thash_string_node *)data;
@@ -156,16 +292,43 @@ static tint category_free_internal(void *data, void *userdata)
     free(cat_node->category.name);
     for (tuint32 i = 0; i < cat_node->category.count; ++i)
     {
-        if (NULL != cat_node->category.rules[i].fd)
+        FILE *fd = cat_node->category.rules[i].fd;
+        if (NULL != fd)
         {
-            fclose(cat_node->category.rules[i].fd);
+            /* standard streams belong to process, keep them open */
+            if ((stdout == fd) || (stderr == fd))
+            {
+                fflush(fd);
+            }
+            else if ('|' == cat_node->category.rules[i].output[0])
+            {
+                pclose(fd);
+            }
+            else
+            {
+                fclose(fd);
+            }
             free(cat_node->category.rules[i].output);
         }
+        rule_close_rotate(&cat_node->category.rules[i]);
+        /* stream buffer is used until stream closed */
+        free(cat_node->category.rules[i].buffer);
+        if (NULL != cat_node->category.rules[i].binary)
+        {
+            binary_free(cat_node->category.rules[i].binary);
+        }
+        if (NULL != cat_node->category.rules[i].folded)
+        {
+            split_format_free(cat_node->category.rules[i].folded);
+        }
+        if (NULL != cat_node->category.rules[i].folded_child)
+        {
+            split_format_free(cat_node->category.rules[i].folded_child);
+        }
     }
     free(cat_node->category.rules);
     free(string_node->key);
     free(cat_node);
-    return 0;
 }
 
 /**
@@ -203,14 +366,37 @@ static category_node *add_category_node(thash_string **hash, const tchar *name,
         if (0 == t_hash_string_init_node(&cat_node->node, name))
         {
             *hash = t_hash_string_insert(*hash, &cat_node->node);
+            cat_node->category.head.level_mask = 0;
             cat_node->category.count = 0;
+            cat_node->category.deferrable = TRUE;
             for (tuint32 i = 0; i < count; ++i)
             {
                 cat_node->category.rules[i].level = TLOG_DEBUG;
                 cat_node->category.rules[i].format = NULL;
                 cat_node->category.rules[i].splits = NULL;
+                cat_node->category.rules[i].folded = NULL;
+                cat_node->category.rules[i].folded_child = NULL;
+                cat_node->category.rules[i].pid = 0;
                 cat_node->category.rules[i].output = NULL;
                 cat_node->category.rules[i].fd = NULL;
+                cat_node->category.rules[i].binary = NULL;
+                cat_node->category.rules[i].buffer = NULL;
+                cat_node->category.rules[i].buffer_size = RULE_BUFFER_DEFAULT;
+                cat_node->category.rules[i].flush_level = 0;
+                cat_node->category.rules[i].flush_age_ms = 0;
+                cat_node->category.rules[i].last_flush_ns = 0;
+                cat_node->category.rules[i].dirty = 0;
+                cat_node->category.rules[i].sync_again = FALSE;
+                cat_node->category.rules[i].path = NULL;
+                cat_node->category.rules[i].max_size = 0;
+                cat_node->category.rules[i].max_files = RULE_MAX_FILES_DEFAULT;
+                cat_node->category.rules[i].size = 0;
+                cat_node->category.rules[i].next_fd = -1;
+                cat_node->category.rules[i].next_size = 0;
+                cat_node->category.rules[i].old_fd = -1;
+                cat_node->category.rules[i].unit = SWITCH_NONE;
+                cat_node->category.rules[i].switch_sec = RULE_SWITCH_NEVER;
+                cat_node->category.rules[i].switch_pending = FALSE;
             }
         }
         else
@@ -261,7 +447,7 @@ tint categories_init(const tkeyfile *keyfile, thash_string **hash)
                 if (NULL == cat_node)
                 {
                     t_slist_free(&name_head, free_name_list);
-                    t_hash_string_foreach(*hash, category_free_internal, NULL);
+                    t_hash_string_clear(*hash, category_free_internal);
                     return -ENOMEM;
                 }
             }
@@ -282,8 +468,7 @@ tint categories_init(const tkeyfile *keyfile, thash_string **hash)
 void category_free(thash_string *cat_hash)
 {
     T_ASSERT(NULL != cat_hash);
-    t_hash_string_foreach(cat_hash, category_free_internal, NULL);
-    free(cat_hash);
+    t_hash_string_free(cat_hash, category_free_internal);
 }
 
 /**
@@ -377,20 +562,30 @@ static tbool output_format_validation(const tchar *output)
 /**
  * @brief convert output name
  * @param name - name output
+ * @param size - name buffer size
  * @param output - output format
- * @return error code, 0 means no error
+ * @param tm - time of name
+ * @return error code, 0 means no error, -EINVAL means invalid
+ *         format or name is longer than buffer
  */
-static tint output_convert_quick(tchar *name, const tchar *output)
+static tint output_convert_quick(tchar *name, tuint32 size, const tchar *output,
+        time_t tm)
 {
     T_ASSERT(NULL != name);
     T_ASSERT(NULL != output);
+    T_ASSERT(size > 0);
 
-    tint name_index = 0, out_index = 0;
+    tuint32 name_index = 0;
+    tint out_index = 0;
 
     while ('\0' != output[out_index])
     {
         if ('%' != output[out_index])
         {
+            if (name_index + 1 >= size)
+            {
+                return -EINVAL;
+            }
             name[name_index] = output[out_index];
             name_index ++;
             out_index ++;
@@ -400,14 +595,24 @@ static tint output_convert_quick(tchar *name, const tchar *output)
             out_index += 3;
             tint index = t_string_find_char(output, out_index, ')', TRUE);
             tchar time_str[32];
-            strncpy(time_str, output + out_index, index - out_index);
-            time_str[index] = '\0';
+            if ((-1 == index) || (index - out_index >= (tint)sizeof(time_str)))
+            {
+                return -EINVAL;
+            }
+            memcpy(time_str, output + out_index, index - out_index);
+            time_str[index - out_index] = '\0';
             out_index = index + 1;
-            time_t tm = time(NULL);
             struct tm ltm;
             if (NULL != localtime_r(&tm, &ltm))
             {
-                name_index += strftime(name + name_index, 99, time_str, &ltm);
+                /* 0 means not enough space, unless time format is empty */
+                size_t len = strftime(name + name_index, size - name_index,
+                        time_str, &ltm);
+                if ((0 == len) && ('\0' != time_str[0]))
+                {
+                    return -EINVAL;
+                }
+                name_index += len;
             }
         }
     }
@@ -416,12 +621,242 @@ static tint output_convert_quick(tchar *name, const tchar *output)
     return 0;
 }
 
+/**
+ * @brief get finest time unit used in output file name
+ * @param output - output format
+ * @return time unit, SWITCH_NONE means file name never changes
+ */
+static switch_unit output_switch_unit(const tchar *output)
+{
+    switch_unit unit = SWITCH_NONE;
+    tbool in_time = FALSE;
+    for (; '\0' != *output; ++output)
+    {
+        if (!in_time)
+        {
+            /* only %d(...) changes with time */
+            if (('%' == output[0]) && ('d' == output[1]) && ('(' == output[2]))
+            {
+                in_time = TRUE;
+                output += 2;
+            }
+            continue;
+        }
+
+        if (')' == *output)
+        {
+            in_time = FALSE;
+            continue;
+        }
+
+        if (('%' != *output) || ('\0' == output[1]))
+        {
+            continue;
+        }
+        output++;
+        /* alternative representation modifier */
+        if ((('E' == *output) || ('O' == *output)) && ('\0' != output[1]))
+        {
+            output++;
+        }
+
+        switch_unit cur = SWITCH_DAY;
+        switch (*output)
+        {
+        case 'S':
+        case 's':
+        case 'T':
+        case 'r':
+        case 'X':
+        case 'c':
+            cur = SWITCH_SECOND;
+            break;
+        case 'M':
+        case 'R':
+            cur = SWITCH_MINUTE;
+            break;
+        case 'H':
+        case 'I':
+        case 'k':
+        case 'l':
+        case 'p':
+        case 'P':
+            cur = SWITCH_HOUR;
+            break;
+        case '%':
+        case 'n':
+        case 't':
+        case 'z':
+        case 'Z':
+            cur = SWITCH_NONE;
+            break;
+        default:
+            break;
+        }
+        if (cur > unit)
+        {
+            unit = cur;
+        }
+    }
+
+    return unit;
+}
+
+/**
+ * @brief get start of next time unit in local time
+ * @param unit - time unit
+ * @param sec - current time
+ * @return start time of next unit
+ */
+static time_t switch_next_boundary(switch_unit unit, time_t sec)
+{
+    struct tm ltm;
+    switch (unit)
+    {
+    case SWITCH_SECOND:
+        return sec + 1;
+    case SWITCH_MINUTE:
+        return sec - ((sec % 60) + 60) % 60 + 60;
+    case SWITCH_HOUR:
+    case SWITCH_DAY:
+        if (NULL == localtime_r(&sec, &ltm))
+        {
+            return sec + 1;
+        }
+        ltm.tm_min = 0;
+        ltm.tm_sec = 0;
+        if (SWITCH_HOUR == unit)
+        {
+            ltm.tm_hour++;
+        }
+        else
+        {
+            ltm.tm_hour = 0;
+            ltm.tm_mday++;
+        }
+        /* let mktime decide daylight saving time */
+        ltm.tm_isdst = -1;
+        time_t next = mktime(&ltm);
+        return (next > sec) ? next : sec + 1;
+    default:
+        return sec + 1;
+    }
+}
+
+/**
+ * @brief schedule next file name change, name may keep same in some
+ *        boundaries, such as month name checked at days
+ * @param cat_rule - category rule
+ * @param now - current time
+ */
+static void rule_schedule_switch(category_rule *cat_rule, time_t now)
+{
+    tchar name[RULE_PATH_MAX];
+    tchar next_name[RULE_PATH_MAX];
+    tint64 switch_sec = RULE_SWITCH_NEVER;
+    if (0 == output_convert_quick(name, sizeof(name), cat_rule->output, now))
+    {
+        time_t next = now;
+        for (tuint32 i = 0; i < RULE_SWITCH_TRIES; ++i)
+        {
+            next = switch_next_boundary(cat_rule->unit, next);
+            if ((0 == output_convert_quick(next_name, sizeof(next_name),
+                        cat_rule->output, next)) &&
+                (0 != strcmp(name, next_name)))
+            {
+                switch_sec = next;
+                break;
+            }
+        }
+    }
+
+    __atomic_store_n(&cat_rule->switch_sec, switch_sec, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief pre-open next file of rule, so rotating never waits for open
+ * @param cat_rule - category rule
+ * @return error code, 0 means no error
+ */
+static tint rule_open_next(category_rule *cat_rule)
+{
+    tchar name[RULE_PATH_MAX];
+    snprintf(name, sizeof(name), "%s.next", cat_rule->path);
+    tint fd = open(name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+
+    /* left by last process if not empty */
+    struct stat st;
+    cat_rule->next_size = (0 == fstat(fd, &st)) ? (tuint64)st.st_size : 0;
+    __atomic_store_n(&cat_rule->next_fd, fd, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief open file output, stdio stream over O_APPEND fd is fully
+ *        buffered by rule owned buffer of page multiple size, so stream
+ *        writes whole pages when buffer fills, and partial buffer only
+ *        on flush_level record, flush_age expiry or explicit flush
+ * @param filename - file name
+ * @param cat_rule - category rule
+ * @return file handle, NULL means error happend
+ */
+static FILE *open_file_output(const tchar *filename, category_rule *cat_rule)
+{
+    tint fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    FILE *fp = fdopen(fd, "a");
+    if (NULL == fp)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    tuint32 page = (tuint32)sysconf(_SC_PAGESIZE);
+    cat_rule->buffer_size = (cat_rule->buffer_size + page - 1) / page * page;
+    cat_rule->buffer = malloc(cat_rule->buffer_size);
+    if (NULL != cat_rule->buffer)
+    {
+        setvbuf(fp, cat_rule->buffer, _IOFBF, cat_rule->buffer_size);
+    }
+
+    cat_rule->path = malloc(strlen(filename) + 1);
+    if (NULL == cat_rule->path)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    strcpy(cat_rule->path, filename);
+
+    if (0 != cat_rule->max_size)
+    {
+        struct stat st;
+        cat_rule->size = (0 == fstat(fd, &st)) ? (tuint64)st.st_size : 0;
+        if (0 != rule_open_next(cat_rule))
+        {
+            fclose(fp);
+            return NULL;
+        }
+    }
+
+    return fp;
+}
+
 /**
  * @brief get output file handle
  * @param output - output string
+ * @param cat_rule - category rule
  * @return file handle, -1 means error happend
  */
-static FILE *get_output_fd(const tchar *output)
+static FILE *get_output_fd(const tchar *output, category_rule *cat_rule)
 {
     T_ASSERT(NULL != output);
 
@@ -448,10 +883,10 @@ static FILE *get_output_fd(const tchar *output)
         else
         {
             /* file */
-            tchar filename[256];
-            if (0 == output_convert_quick(filename, output))
+            tchar filename[RULE_PATH_MAX];
+            if (0 == output_convert_quick(filename, sizeof(filename), output, time(NULL)))
             {
-                return fopen(filename, "a");
+                return open_file_output(filename, cat_rule);
             }
             else
             {
@@ -465,6 +900,210 @@ static FILE *get_output_fd(const tchar *output)
     return NULL;
 }
 
+/**
+ * @brief recalculate category level mask, must be called after
+ *        any rule level changed
+ * @param cat - category handle
+ */
+static void category_update_level_mask(tlog_category *cat)
+{
+    tuint32 mask = 0;
+    for (tuint32 i = 0; i < cat->count; ++i)
+    {
+        mask |= (cat->rules[i].level & LEVEL_MASK);
+    }
+    __atomic_store_n(&cat->head.level_mask, mask, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief parse size option value, k and m suffix are supported
+ * @param value - value string
+ * @param size - size output
+ * @return TRUE: valid size
+ */
+static tbool parse_size(const tchar *value, tuint32 *size)
+{
+    tchar *end = NULL;
+    errno = 0;
+    unsigned long long num = strtoull(value, &end, 10);
+    if ((end == value) || (0 != errno) || ('-' == *value))
+    {
+        return FALSE;
+    }
+
+    if (('k' == *end) || ('K' == *end))
+    {
+        num *= 1024;
+        end++;
+    }
+    else if (('m' == *end) || ('M' == *end))
+    {
+        num *= 1024 * 1024;
+        end++;
+    }
+    if (('\0' != *end) || (num > 0xffffffffULL))
+    {
+        return FALSE;
+    }
+
+    *size = (tuint32)num;
+    return TRUE;
+}
+
+/**
+ * @brief parse millisecond option value, no suffix is supported
+ * @param value - value string
+ * @param ms - millisecond output
+ * @return TRUE: valid value
+ */
+static tbool parse_ms(const tchar *value, tuint32 *ms)
+{
+    tchar *end = NULL;
+    errno = 0;
+    unsigned long long num = strtoull(value, &end, 10);
+    if ((end == value) || (0 != errno) || ('-' == *value) ||
+        ('\0' != *end) || (num > 0xffffffffULL))
+    {
+        return FALSE;
+    }
+
+    *ms = (tuint32)num;
+    return TRUE;
+}
+
+/**
+ * @brief parse rule options, options are separated by ','
+ * @param cat_rule - category rule
+ * @param options - options string
+ * @return error code, 0 means no error
+ */
+static tint rule_parse_options(category_rule *cat_rule, const tchar *options)
+{
+    T_ASSERT(NULL != cat_rule);
+    T_ASSERT(NULL != options);
+
+    tchar buf[256];
+    tchar option[256];
+    tuint32 start = 0;
+    while ('\0' != options[start])
+    {
+        tint index = t_string_find_char(options, start, ',', TRUE);
+        tuint32 len = (-1 != index) ? (tuint32)index - start : strlen(options) - start;
+        if (len >= sizeof(buf))
+        {
+            return -EINVAL;
+        }
+        memcpy(buf, options + start, len);
+        buf[len] = '\0';
+        t_string_trimmed(buf, option);
+
+        /* key:value option, '=' separates rule key and value */
+        tchar *value = strchr(option, ':');
+        if (NULL != value)
+        {
+            tchar *key_end = value;
+            while ((key_end > option) && (' ' == key_end[-1]))
+            {
+                key_end--;
+            }
+            *key_end = '\0';
+            value++;
+            while (' ' == *value)
+            {
+                value++;
+            }
+        }
+
+        if (0 == strcmp("binary", option))
+        {
+            if (NULL != value)
+            {
+                return -EINVAL;
+            }
+            if (NULL == cat_rule->binary)
+            {
+                cat_rule->binary = binary_new();
+                if (NULL == cat_rule->binary)
+                {
+                    return -ENOMEM;
+                }
+            }
+        }
+        else if ((0 == strcmp("buffer", option)) && (NULL != value))
+        {
+            tuint32 size = 0;
+            if (!parse_size(value, &size) || (0 == size) || (size > RULE_BUFFER_MAX))
+            {
+                return -EINVAL;
+            }
+            cat_rule->buffer_size = size;
+        }
+        else if ((0 == strcmp("flush_age", option)) && (NULL != value))
+        {
+            tuint32 age = 0;
+            if (!parse_ms(value, &age))
+            {
+                return -EINVAL;
+            }
+            cat_rule->flush_age_ms = age;
+        }
+        else if ((0 == strcmp("flush_level", option)) && (NULL != value))
+        {
+            cat_rule->flush_level = log_level_convert(value);
+            if (0 == cat_rule->flush_level)
+            {
+                return -EINVAL;
+            }
+        }
+        else if ((0 == strcmp("max_size", option)) && (NULL != value))
+        {
+            if (!parse_size(value, &cat_rule->max_size))
+            {
+                return -EINVAL;
+            }
+        }
+        else if ((0 == strcmp("max_files", option)) && (NULL != value))
+        {
+            if (!parse_size(value, &cat_rule->max_files))
+            {
+                return -EINVAL;
+            }
+        }
+        else if (0 != strcmp("", option))
+        {
+            return -EINVAL;
+        }
+
+        start += len;
+        if (-1 != index)
+        {
+            start++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief write binary file header
+ * @param cat_rule - category rule
+ * @return error code, 0 means no error
+ */
+static tint rule_write_binary_header(const category_rule *cat_rule)
+{
+    tbuffer buf;
+    t_buffer_init(&buf);
+    tint err = binary_write_header(&buf, cat_rule->format);
+    if (0 == err)
+    {
+        fwrite(buf.data, 1, buf.len, cat_rule->fd);
+        fflush(cat_rule->fd);
+    }
+    t_buffer_free(&buf);
+
+    return err;
+}
+
 /**
  * @brief add level value to hash table
  * @param cat_hash - category hash table handle
@@ -473,10 +1112,12 @@ static FILE *get_output_fd(const tchar *output)
  * @param level - level string
  * @param format - format string
  * @param output - output string
+ * @param options - rule options string
  */
 tint add_category(thash_string *cat_hash, const thash_string *format_hash, 
         const tchar *name, const tchar *level, 
-        const tchar *format, const tchar *output)
+        const tchar *format, const tchar *output,
+        const tchar *options)
 {
     T_ASSERT(NULL != cat_hash);
     T_ASSERT(NULL != name);
@@ -507,6 +1148,43 @@ tint add_category(thash_string *cat_hash, const thash_string *format_hash,
         //format = DEFAULT_FORMAT_NAME;
     }
     cat_rule->splits = get_format_split(format_hash, format);
+    /* mdc belongs to caller thread, can not be formatted in writer thread */
+    if (format_split_has_mdc(cat_rule->splits))
+    {
+        cat_node->category.deferrable = FALSE;
+    }
+
+    /* render process constant splits once */
+    const thread_identity *ident = identity_current();
+    cat_rule->folded = format_split_fold(cat_rule->splits, name, ident);
+    cat_rule->folded_child = format_split_fold(cat_rule->splits, name, NULL);
+    if ((NULL == cat_rule->folded) || (NULL == cat_rule->folded_child))
+    {
+        return -ENOMEM;
+    }
+    cat_rule->pid = (NULL != ident) ? ident->pid : 0;
+
+    /* add options, output depends on them */
+    tint err = rule_parse_options(cat_rule, options);
+    if (0 != err)
+    {
+        return err;
+    }
+    /*
+     * binary file starts with header and call site dictionary, so it
+     * can not be rotated or switched, size rotating renames files of
+     * current name
+     */
+    switch_unit unit = output_switch_unit(output);
+    if (((NULL != cat_rule->binary) &&
+         ((0 != cat_rule->max_size) || (SWITCH_NONE != unit))) ||
+        ((0 != cat_rule->max_size) && (SWITCH_NONE != unit)))
+    {
+        return -EINVAL;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    cat_rule->last_flush_ns = (tuint64)now.tv_sec * 1000000000ULL + now.tv_nsec;
 
     /* add output */
     tuint32 out_len = 0;
@@ -530,7 +1208,7 @@ tint add_category(thash_string *cat_hash, const thash_string *format_hash,
             strcpy(cat_rule->output, output);
         }
 
-        cat_rule->fd = get_output_fd(output);
+        cat_rule->fd = get_output_fd(output, cat_rule);
         if (NULL == cat_rule->fd)
         {
             return errno;
@@ -541,7 +1219,27 @@ tint add_category(thash_string *cat_hash, const thash_string *format_hash,
         return -ENOMEM;
     }
 
+    if (NULL != cat_rule->binary)
+    {
+        err = rule_write_binary_header(cat_rule);
+        if (0 != err)
+        {
+            return err;
+        }
+    }
+
+    /* file name changes with time */
+    if (NULL != cat_rule->path)
+    {
+        cat_rule->unit = output_switch_unit(cat_rule->output);
+        if (SWITCH_NONE != cat_rule->unit)
+        {
+            rule_schedule_switch(cat_rule, time(NULL));
+        }
+    }
+
     cat_node->category.count++;
+    category_update_level_mask(&cat_node->category);
 
     return 0;
 }
@@ -571,36 +1269,738 @@ tlog_category *get_category(const thash_string *hash, const tchar *name)
 }
 
 /**
- * @brief generate log message
- * @param cat - category handle
- * @param file - file name
- * @param line - line
- * @param func - function name
- * @param line_str - line string
- * @param level - level 
- * @param pmdc - mdc handle
- * @param fmt - user message
+ * @brief free render context when thread exit
+ * @param data - render context
  */
-void category_gen_log(const tlog_category *cat, const tchar *file,
-        tlong line, const tchar *func, const tchar *line_str,
-        tuint32 level, const tchar *msg, const mdc *pmdc)
+static void render_context_free(void *data)
 {
-    T_ASSERT(NULL != cat);
-    tchar msg_buf[512];
-    preprocess_info pre = {file, func, line, line_str, level, msg, pmdc};
-    tuint32 count = 0;
+    render_context *ctx = (render_context *)data;
+    t_buffer_free(&ctx->msg);
+    t_buffer_free(&ctx->record);
+    free(ctx);
+}
+
+/**
+ * @brief create render context key
+ */
+static void render_key_create(void)
+{
+    pthread_key_create(&render_key, render_context_free);
+}
+
+/**
+ * @brief get render context of current thread
+ * @return render context, NULL means no memory
+ */
+static render_context *get_render_context(void)
+{
+    pthread_once(&render_once, render_key_create);
+    render_context *ctx = pthread_getspecific(render_key);
+    if (NULL == ctx)
+    {
+        ctx = malloc(sizeof(render_context));
+        if (NULL == ctx)
+        {
+            return NULL;
+        }
+        t_buffer_init(&ctx->msg);
+        t_buffer_init(&ctx->record);
+        ctx->ident_valid = FALSE;
+        if (0 != pthread_setspecific(render_key, ctx))
+        {
+            free(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+/**
+ * @brief check if rule output should be flushed after record
+ * @param cat_rule - category rule
+ * @param pre - preprocess information
+ * @return TRUE: flush output
+ */
+static tbool rule_need_flush(category_rule *cat_rule, const preprocess_info *pre)
+{
+    tuint64 now = (tuint64)pre->ts.tv_sec * 1000000000ULL + pre->ts.tv_nsec;
+    if (0 != ((cat_rule->flush_level & pre->site->level) & LEVEL_MASK))
+    {
+        __atomic_store_n(&cat_rule->last_flush_ns, now, __ATOMIC_RELAXED);
+        return TRUE;
+    }
+
+    if (0 == cat_rule->flush_age_ms)
+    {
+        return FALSE;
+    }
+
+    /* only one thread flushes when age expired */
+    tuint64 last = __atomic_load_n(&cat_rule->last_flush_ns, __ATOMIC_RELAXED);
+    if (now - last < (tuint64)cat_rule->flush_age_ms * 1000000ULL)
+    {
+        return FALSE;
+    }
+
+    return __atomic_compare_exchange_n(&cat_rule->last_flush_ns, &last, now,
+            FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief check if rule output is a regular file
+ * @param cat_rule - category rule
+ * @return TRUE: file output
+ */
+static inline tbool rule_is_file(const category_rule *cat_rule)
+{
+    return ('>' != cat_rule->output[0]) && ('|' != cat_rule->output[0]);
+}
+
+/**
+ * @brief account written bytes of file rule, wake flusher when dirty
+ *        bytes reach threshold
+ * @param cat_rule - category rule
+ * @param len - written bytes
+ */
+static void rule_mark_dirty(category_rule *cat_rule, tuint32 len)
+{
+    tuint64 dirty = __atomic_add_fetch(&cat_rule->dirty, len, __ATOMIC_RELAXED);
+    /* only the record crossing threshold kicks */
+    if ((0 != sync_bytes) && (dirty >= sync_bytes) && (dirty - len < sync_bytes))
+    {
+        flusher_kick(sync_flusher);
+    }
+}
+
+/**
+ * @brief switch rule output to pre-opened next file, stream is kept
+ *        so queued records and other threads use it safely, renaming
+ *        is left to rotate thread
+ * @param cat_rule - category rule
+ */
+static void rule_rotate(category_rule *cat_rule)
+{
+    /* not pre-opened yet, or rotated by other thread */
+    tint next = __atomic_exchange_n(&cat_rule->next_fd, -1, __ATOMIC_ACQUIRE);
+    if (-1 == next)
+    {
+        return;
+    }
+
+    tint fd = fileno(cat_rule->fd);
+    tint old = dup(fd);
+    if (old < 0)
+    {
+        __atomic_store_n(&cat_rule->next_fd, next, __ATOMIC_RELEASE);
+        return;
+    }
+
+    flockfile(cat_rule->fd);
+    fflush(cat_rule->fd);
+    dup2(next, fd);
+    funlockfile(cat_rule->fd);
+    close(next);
+
+    __atomic_store_n(&cat_rule->size, cat_rule->next_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&cat_rule->old_fd, old, __ATOMIC_RELEASE);
+    flusher_kick(rotate_flusher);
+}
+
+/**
+ * @brief request rotate thread to switch file of new time
+ * @param cat_rule - category rule
+ * @param switch_sec - switch time already reached
+ */
+static void rule_request_switch(category_rule *cat_rule, tint64 switch_sec)
+{
+    if (NULL == rotate_flusher)
+    {
+        return;
+    }
+
+    /* only one thread requests */
+    if (__atomic_compare_exchange_n(&cat_rule->switch_sec, &switch_sec,
+                RULE_SWITCH_NEVER, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&cat_rule->switch_pending, TRUE, __ATOMIC_RELEASE);
+        flusher_kick(rotate_flusher);
+    }
+}
+
+/**
+ * @brief write log message to all matched rules
+ * @param cat - category handle
+ * @param pre - preprocess information
+ * @param record - record render buffer
+ * @param async - async logger handle, NULL means write directly
+ */
+static void category_write(const tlog_category *cat, const preprocess_info *pre,
+        tbuffer *record, async_logger *async)
+{
+    /* folded pid is stale in forked child */
+    const thread_identity *ident = (NULL != pre->ident) ? pre->ident : identity_current();
+    pid_t pid = (NULL != ident) ? ident->pid : 0;
     for (tuint32 i = 0; i < cat->count; ++i)
     {
-        if (0 != ((cat->rules[i].level & level) & LEVEL_MASK))
+        if (0 != ((cat->rules[i].level & pre->site->level) & LEVEL_MASK))
         {
-            count = format_split_to_string(msg_buf, cat->rules[i].splits, &pre);
-            fwrite(msg_buf, 1, count, cat->rules[i].fd);
+            t_buffer_clear(record);
+            if (NULL != cat->rules[i].binary)
+            {
+                binary_encode(cat->rules[i].binary, record, pre);
+            }
+            else
+            {
+                format_split_to_string(record, (pid == cat->rules[i].pid) ?
+                        cat->rules[i].folded : cat->rules[i].folded_child, pre);
+            }
+            if (0 == record->len)
+            {
+                continue;
+            }
+
+            tbool flush = rule_need_flush(&cat->rules[i], pre);
+            if (NULL != async)
+            {
+                async_push(async, cat->rules[i].fd, record->data, record->len);
+                if (flush)
+                {
+                    async_flush(async, cat->rules[i].fd);
+                }
+            }
+            else
+            {
+                fwrite(record->data, 1, record->len, cat->rules[i].fd);
+                if (flush)
+                {
+                    fflush(cat->rules[i].fd);
+                }
+            }
+
+            if ((NULL != sync_flusher) && rule_is_file(&cat->rules[i]))
+            {
+                rule_mark_dirty(&cat->rules[i], record->len);
+            }
+
+            tint64 switch_sec = __atomic_load_n(&cat->rules[i].switch_sec, __ATOMIC_RELAXED);
+            if ((tint64)pre->ts.tv_sec >= switch_sec)
+            {
+                rule_request_switch(&cat->rules[i], switch_sec);
+            }
+
+            if ((0 != cat->rules[i].max_size) && (NULL != rotate_flusher) &&
+                (__atomic_add_fetch(&cat->rules[i].size, record->len, __ATOMIC_RELAXED) >=
+                 cat->rules[i].max_size))
+            {
+                rule_rotate(&cat->rules[i]);
+            }
         }
     }
 }
 
+/**
+ * @brief generate log message
+ * @param cat - category handle
+ * @param site - call site information
+ * @param fmt - user message format
+ * @param args - user message arguments, not changed
+ * @param pmdc - mdc handle
+ * @param async - async logger handle, NULL means write directly
+ */
+void category_gen_log(const tlog_category *cat, const tlog_callsite *site,
+        const tchar *fmt, va_list args, const mdc *pmdc, async_logger *async)
+{
+    T_ASSERT(NULL != cat);
+    T_ASSERT(NULL != site);
+
+    render_context *ctx = get_render_context();
+    if (NULL == ctx)
+    {
+        return;
+    }
+
+    /* user message is rendered in place by every matched rule */
+    va_list msg_args;
+    va_copy(msg_args, args);
+    preprocess_info pre;
+    pre.site = site;
+    pre.user_msg = NULL;
+    pre.fmt = fmt;
+    pre.args = &msg_args;
+    pre.packed = NULL;
+    pre.packed_len = 0;
+    pre.fields = NULL;
+    pre.field_count = 0;
+    pre.msg_buf = &ctx->msg;
+    pre.mdc_handle = pmdc;
+    timestamp_now(&pre.ts, &pre.uptime);
+    pre.ident = NULL;
+    category_write(cat, &pre, &ctx->record, async);
+    va_end(msg_args);
+}
+
+/**
+ * @brief generate structured log message
+ * @param cat - category handle
+ * @param site - call site information
+ * @param msg - user message, not formatted
+ * @param fields - structured fields
+ * @param count - field count
+ * @param pmdc - mdc handle
+ * @param async - async logger handle, NULL means write directly
+ */
+void category_gen_kv_log(const tlog_category *cat, const tlog_callsite *site,
+        const tchar *msg, const tlog_field *fields, tuint32 count,
+        const mdc *pmdc, async_logger *async)
+{
+    T_ASSERT(NULL != cat);
+    T_ASSERT(NULL != site);
+
+    render_context *ctx = get_render_context();
+    if (NULL == ctx)
+    {
+        return;
+    }
+
+    preprocess_info pre;
+    pre.site = site;
+    pre.user_msg = (NULL != msg) ? msg : "";
+    pre.fmt = NULL;
+    pre.args = NULL;
+    pre.packed = NULL;
+    pre.packed_len = 0;
+    pre.fields = fields;
+    pre.field_count = count;
+    pre.msg_buf = &ctx->msg;
+    pre.mdc_handle = pmdc;
+    timestamp_now(&pre.ts, &pre.uptime);
+    pre.ident = NULL;
+    category_write(cat, &pre, &ctx->record, async);
+}
+
+/**
+ * @brief write deferred log record, called in writer thread
+ * @param data - deferred record
+ * @param len - record length
+ */
+static void write_deferred(const tchar *data, tuint32 len)
+{
+    const deferred_record *record = (const deferred_record *)data;
+
+    render_context *ctx = get_render_context();
+    if (NULL == ctx)
+    {
+        return;
+    }
+
+    /* records of same thread usually come in batch, render identity once */
+    if ((!ctx->ident_valid) ||
+        (!pthread_equal(ctx->ident.tid, record->tid)) ||
+        (ctx->ident.ktid != record->ktid) ||
+        (ctx->ident.pid != record->pid) ||
+        (0 != strcmp(ctx->ident.name, record->name)))
+    {
+        identity_init(&ctx->ident, record->tid, record->ktid, record->pid,
+                record->name);
+        ctx->ident_valid = TRUE;
+    }
+
+    preprocess_info pre;
+    pre.site = record->site;
+    pre.user_msg = NULL;
+    pre.fmt = (const tchar *)(record + 1) + record->pack_len;
+    pre.args = NULL;
+    pre.packed = (const tchar *)(record + 1);
+    pre.packed_len = record->pack_len;
+    pre.fields = NULL;
+    pre.field_count = 0;
+    pre.msg_buf = &ctx->msg;
+    pre.mdc_handle = NULL;
+    pre.ts = record->ts;
+    pre.uptime = record->uptime;
+    pre.ident = &ctx->ident;
+    category_write(record->cat, &pre, &ctx->record, NULL);
+}
+
+/**
+ * @brief queue log arguments to writer thread, the message
+ *        will be formatted in writer thread
+ * @param cat - category handle
+ * @param site - call site information, must be static
+ * @param fmt - user message format
+ * @param args - user message arguments, not changed
+ * @param async - async logger handle
+ * @return TRUE: queued, FALSE: need to generate log in caller thread
+ */
+tbool category_defer_log(const tlog_category *cat, const tlog_callsite *site,
+        const tchar *fmt, va_list args, async_logger *async)
+{
+    T_ASSERT(NULL != cat);
+    T_ASSERT(NULL != site);
+    T_ASSERT(NULL != async);
+
+    if (!cat->deferrable)
+    {
+        return FALSE;
+    }
+
+    va_list pack_args;
+    va_copy(pack_args, args);
+    tint pack_len = argpack_size(fmt, pack_args);
+    va_end(pack_args);
+    if (pack_len < 0)
+    {
+        return FALSE;
+    }
+
+    const thread_identity *ident = identity_current();
+    if (NULL == ident)
+    {
+        return FALSE;
+    }
+
+    tuint32 fmt_len = strlen(fmt) + 1;
+    deferred_record *record = (deferred_record *)async_reserve(async,
+            sizeof(deferred_record) + pack_len + fmt_len);
+    if (NULL == record)
+    {
+        return FALSE;
+    }
+
+    record->cat = cat;
+    record->site = site;
+    record->pack_len = pack_len;
+    memcpy((tchar *)(record + 1) + pack_len, fmt, fmt_len);
+    timestamp_now(&record->ts, &record->uptime);
+    record->tid = ident->tid;
+    record->ktid = ident->ktid;
+    record->pid = ident->pid;
+    memcpy(record->name, ident->name, IDENTITY_NAME_LEN);
+    va_copy(pack_args, args);
+    argpack_pack((tchar *)(record + 1), fmt, pack_args);
+    va_end(pack_args);
+    async_commit(async, write_deferred);
+
+    return TRUE;
+}
+
 
 
+/**
+ * @brief set background file sync, called before any record written
+ *        and after all records written
+ * @param pflusher - flusher handle, NULL means never sync
+ * @param dirty_bytes - kick flusher when dirty bytes of a rule reach it,
+ *        0 means only sync at intervals
+ */
+void categories_set_flusher(flusher *pflusher, tuint32 dirty_bytes)
+{
+    sync_flusher = pflusher;
+    sync_bytes = dirty_bytes;
+}
+
+/**
+ * @brief sync dirty file outputs of category
+ * @param data - hash node
+ * @param userdata - TRUE if records are written by async writer thread
+ */
+static tint category_sync(void *data, void *userdata)
+{
+    tbool async = *(const tbool *)userdata;
+    category_node *cat_node = t_hash_string_entry((thash_string_node *)data,
+            category_node, node);
+    for (tuint32 i = 0; i < cat_node->category.count; ++i)
+    {
+        category_rule *cat_rule = &cat_node->category.rules[i];
+        if ((NULL == cat_rule->fd) || !rule_is_file(cat_rule))
+        {
+            continue;
+        }
+
+        tuint64 dirty = __atomic_exchange_n(&cat_rule->dirty, 0, __ATOMIC_RELAXED);
+        if ((0 != dirty) || cat_rule->sync_again)
+        {
+            /* stream is locked by stdio, safe with writing threads */
+            fflush(cat_rule->fd);
+            fdatasync(fileno(cat_rule->fd));
+        }
+
+        /* queued records may reach stream after this sync */
+        cat_rule->sync_again = async && (0 != dirty);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief flush and sync all dirty file outputs to disk, called in
+ *        flusher thread so logging threads never wait for disk
+ * @param cat_hash - category hash table
+ * @param async - TRUE if records are written by async writer thread
+ */
+void categories_sync(const thash_string *cat_hash, tbool async)
+{
+    T_ASSERT(NULL != cat_hash);
+    t_hash_string_foreach(cat_hash, category_sync, &async);
+}
+
+/**
+ * @brief set rotate thread, called before any record written
+ *        and after all records written
+ * @param pflusher - flusher handle, NULL means never rotate
+ */
+void categories_set_rotator(flusher *pflusher)
+{
+    rotate_flusher = pflusher;
+}
+
+/**
+ * @brief check if rule has size limit or time based file name
+ * @param data - hash node
+ * @param userdata - need rotate output
+ */
+static tint category_need_rotate(void *data, void *userdata)
+{
+    category_node *cat_node = t_hash_string_entry((thash_string_node *)data,
+            category_node, node);
+    for (tuint32 i = 0; i < cat_node->category.count; ++i)
+    {
+        if ((0 != cat_node->category.rules[i].max_size) ||
+            (SWITCH_NONE != cat_node->category.rules[i].unit))
+        {
+            *(tbool *)userdata = TRUE;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief check if any rule needs rotate thread
+ * @param cat_hash - category hash table
+ * @return TRUE: some rule has size limit or time based file name
+ */
+tbool categories_need_rotate(const thash_string *cat_hash)
+{
+    T_ASSERT(NULL != cat_hash);
+    tbool need = FALSE;
+    t_hash_string_foreach(cat_hash, category_need_rotate, &need);
+
+    return need;
+}
+
+/**
+ * @brief get smallest flush age of category
+ * @param data - hash node
+ * @param userdata - smallest flush age, 0 means none
+ */
+static tint category_min_flush_age(void *data, void *userdata)
+{
+    category_node *cat_node = t_hash_string_entry((thash_string_node *)data,
+            category_node, node);
+    tuint32 *age = (tuint32 *)userdata;
+    for (tuint32 i = 0; i < cat_node->category.count; ++i)
+    {
+        tuint32 cur = cat_node->category.rules[i].flush_age_ms;
+        if ((0 != cur) && ((0 == *age) || (cur < *age)))
+        {
+            *age = cur;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief get smallest flush age of all rules
+ * @param cat_hash - category hash table
+ * @return smallest flush age in millisecond, 0 means no rule has flush age
+ */
+tuint32 categories_min_flush_age(const thash_string *cat_hash)
+{
+    T_ASSERT(NULL != cat_hash);
+    tuint32 age = 0;
+    t_hash_string_foreach(cat_hash, category_min_flush_age, &age);
+
+    return age;
+}
+
+/**
+ * @brief flush rule outputs of category older than flush age
+ * @param data - hash node
+ * @param userdata - userdata
+ */
+static tint category_flush_aged(void *data, void *userdata)
+{
+    category_node *cat_node = t_hash_string_entry((thash_string_node *)data,
+            category_node, node);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tuint64 now = (tuint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    for (tuint32 i = 0; i < cat_node->category.count; ++i)
+    {
+        category_rule *cat_rule = &cat_node->category.rules[i];
+        if ((0 == cat_rule->flush_age_ms) || (NULL == cat_rule->fd))
+        {
+            continue;
+        }
+
+        /* logging thread may flush it at same time */
+        tuint64 last = __atomic_load_n(&cat_rule->last_flush_ns, __ATOMIC_RELAXED);
+        if ((now > last) &&
+            (now - last >= (tuint64)cat_rule->flush_age_ms * 1000000ULL) &&
+            __atomic_compare_exchange_n(&cat_rule->last_flush_ns, &last, now,
+                FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            /* stream is locked by stdio, safe with writing threads */
+            fflush(cat_rule->fd);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief flush rule outputs whose last flush is older than flush age,
+ *        called in flusher thread so quiet rules are flushed too
+ * @param cat_hash - category hash table
+ */
+void categories_flush_aged(const thash_string *cat_hash)
+{
+    T_ASSERT(NULL != cat_hash);
+    t_hash_string_foreach(cat_hash, category_flush_aged, NULL);
+}
+
+/**
+ * @brief rename replaced file to .1 and shift older files, then
+ *        pre-open next file
+ * @param cat_rule - category rule
+ */
+static void rule_rotate_files(category_rule *cat_rule)
+{
+    tint old = __atomic_exchange_n(&cat_rule->old_fd, -1, __ATOMIC_ACQUIRE);
+    if (-1 == old)
+    {
+        return;
+    }
+    if (NULL != sync_flusher)
+    {
+        fdatasync(old);
+    }
+    close(old);
+
+    tchar from[RULE_PATH_MAX];
+    tchar to[RULE_PATH_MAX];
+    if (0 == cat_rule->max_files)
+    {
+        unlink(cat_rule->path);
+    }
+    else
+    {
+        for (tuint32 i = cat_rule->max_files - 1; i > 0; --i)
+        {
+            snprintf(from, sizeof(from), "%s.%u", cat_rule->path, i);
+            snprintf(to, sizeof(to), "%s.%u", cat_rule->path, i + 1);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", cat_rule->path);
+        rename(cat_rule->path, to);
+    }
+
+    /* stream already writes to next file */
+    snprintf(from, sizeof(from), "%s.next", cat_rule->path);
+    rename(from, cat_rule->path);
+    rule_open_next(cat_rule);
+}
+
+/**
+ * @brief switch rule output to file of current time, stream is kept
+ *        so queued records and other threads use it safely
+ * @param cat_rule - category rule
+ */
+static void rule_switch_files(category_rule *cat_rule)
+{
+    if (!__atomic_exchange_n(&cat_rule->switch_pending, FALSE, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    time_t now = time(NULL);
+    tchar name[RULE_PATH_MAX];
+    tchar *path = NULL;
+    if ((0 == output_convert_quick(name, sizeof(name), cat_rule->output, now)) &&
+        (0 != strcmp(name, cat_rule->path)) &&
+        (NULL != (path = malloc(strlen(name) + 1))))
+    {
+        tint next = open(name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (next >= 0)
+        {
+            tint fd = fileno(cat_rule->fd);
+            tint old = dup(fd);
+            flockfile(cat_rule->fd);
+            fflush(cat_rule->fd);
+            dup2(next, fd);
+            funlockfile(cat_rule->fd);
+            close(next);
+            if (old >= 0)
+            {
+                if (NULL != sync_flusher)
+                {
+                    fdatasync(old);
+                }
+                close(old);
+            }
+
+            strcpy(path, name);
+            free(cat_rule->path);
+            cat_rule->path = path;
+        }
+        else
+        {
+            free(path);
+        }
+    }
+
+    rule_schedule_switch(cat_rule, now);
+}
+
+/**
+ * @brief rotate replaced files of category
+ * @param data - hash node
+ * @param userdata - userdata
+ */
+static tint category_rotate(void *data, void *userdata)
+{
+    category_node *cat_node = t_hash_string_entry((thash_string_node *)data,
+            category_node, node);
+    for (tuint32 i = 0; i < cat_node->category.count; ++i)
+    {
+        if (0 != cat_node->category.rules[i].max_size)
+        {
+            rule_rotate_files(&cat_node->category.rules[i]);
+        }
+        else if (SWITCH_NONE != cat_node->category.rules[i].unit)
+        {
+            rule_switch_files(&cat_node->category.rules[i]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief rename replaced files and pre-open next files, switch files
+ *        of new time, called in rotate thread so logging threads never
+ *        wait for rename or open
+ * @param cat_hash - category hash table
+ */
+void categories_rotate(const thash_string *cat_hash)
+{
+    T_ASSERT(NULL != cat_hash);
+    t_hash_string_foreach(cat_hash, category_rotate, NULL);
+}
+
 /**
  * @brief print category infomation to stdout
  * @param data - hash node
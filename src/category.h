@@ -10,6 +10,9 @@
 
 #include "ttypes.h"
 #include "../include/tlog/tlog.h"
+#include "mdc.h"
+#include "async.h"
+#include "flusher.h"
 #include <stdarg.h>
 
 T_BEGIN_DECLS
@@ -18,12 +21,27 @@ T_EXTERN tint categories_init(const tkeyfile *keyfile, thash_string **hash);
 T_EXTERN void category_free(thash_string *cat_hash);
 T_EXTERN tint add_category(thash_string *cat_hash, const thash_string *format_hash, 
         const tchar *name, const tchar *level, 
-        const tchar *format, const tchar *output);
+        const tchar *format, const tchar *output,
+        const tchar *options);
 T_EXTERN tlog_category *get_category(const thash_string *hash, 
         const tchar *name);
-T_EXTERN void category_gen_log(const tlog_category *cat, const tchar *file, 
-        tlong line, const tchar *func, const tchar *line_str,
-        tuint32 level, const tchar *msg, const mdc *pmdc);
+T_EXTERN void category_gen_log(const tlog_category *cat,
+        const tlog_callsite *site, const tchar *fmt, va_list args,
+        const mdc *pmdc, async_logger *async);
+T_EXTERN void category_gen_kv_log(const tlog_category *cat,
+        const tlog_callsite *site, const tchar *msg,
+        const tlog_field *fields, tuint32 count,
+        const mdc *pmdc, async_logger *async);
+T_EXTERN tbool category_defer_log(const tlog_category *cat,
+        const tlog_callsite *site, const tchar *fmt, va_list args,
+        async_logger *async);
+T_EXTERN void categories_set_flusher(flusher *pflusher, tuint32 dirty_bytes);
+T_EXTERN void categories_sync(const thash_string *cat_hash, tbool async);
+T_EXTERN void categories_set_rotator(flusher *pflusher);
+T_EXTERN tbool categories_need_rotate(const thash_string *cat_hash);
+T_EXTERN void categories_rotate(const thash_string *cat_hash);
+T_EXTERN tuint32 categories_min_flush_age(const thash_string *cat_hash);
+T_EXTERN void categories_flush_aged(const thash_string *cat_hash);
 
 T_EXTERN void print_category(const thash_string *hash);
 
@@ -0,0 +1,167 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "tassert.h"
+#include "flusher.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+struct _flusher
+{
+    /* 0 means only flush when kicked */
+    tuint32 interval_ms;
+    flusher_func func;
+    void *userdata;
+    /* protect running and kicked */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    tbool running;
+    tbool kicked;
+    pthread_t thread;
+};
+
+/****************************************************
+ * static variable
+ ****************************************************/
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief flusher thread, call flush function at intervals or when kicked,
+ *        call it once more before exit
+ * @param arg - flusher handle
+ */
+static void *flusher_thread(void *arg)
+{
+    flusher *pflusher = (flusher *)arg;
+
+    pthread_mutex_lock(&pflusher->mutex);
+    while (pflusher->running)
+    {
+        if (!pflusher->kicked)
+        {
+            if (0 == pflusher->interval_ms)
+            {
+                pthread_cond_wait(&pflusher->cond, &pflusher->mutex);
+            }
+            else
+            {
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                ts.tv_sec += pflusher->interval_ms / 1000;
+                ts.tv_nsec += (pflusher->interval_ms % 1000) * 1000000;
+                if (ts.tv_nsec >= 1000000000)
+                {
+                    ts.tv_sec ++;
+                    ts.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&pflusher->cond, &pflusher->mutex, &ts);
+            }
+        }
+        if (!pflusher->running)
+        {
+            break;
+        }
+        pflusher->kicked = FALSE;
+        pthread_mutex_unlock(&pflusher->mutex);
+
+        /* slow sync does not block kick */
+        pflusher->func(pflusher->userdata);
+
+        pthread_mutex_lock(&pflusher->mutex);
+    }
+    pthread_mutex_unlock(&pflusher->mutex);
+
+    pflusher->func(pflusher->userdata);
+
+    return NULL;
+}
+
+/**
+ * @brief new flusher and start flusher thread
+ * @param interval_ms - flush interval, 0 means only flush when kicked
+ * @param func - flush function
+ * @param userdata - userdata passed to flush function
+ * @return flusher handle
+ */
+flusher *flusher_new(tuint32 interval_ms, flusher_func func, void *userdata)
+{
+    T_ASSERT(NULL != func);
+
+    flusher *pflusher = malloc(sizeof(flusher));
+    if (NULL == pflusher)
+    {
+        return NULL;
+    }
+
+    pflusher->interval_ms = interval_ms;
+    pflusher->func = func;
+    pflusher->userdata = userdata;
+    pflusher->running = TRUE;
+    pflusher->kicked = FALSE;
+    pthread_mutex_init(&pflusher->mutex, NULL);
+
+    /* wall clock change does not affect interval */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pflusher->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (0 != pthread_create(&pflusher->thread, NULL, flusher_thread, pflusher))
+    {
+        pthread_cond_destroy(&pflusher->cond);
+        pthread_mutex_destroy(&pflusher->mutex);
+        free(pflusher);
+        return NULL;
+    }
+
+    return pflusher;
+}
+
+/**
+ * @brief stop flusher thread and free flusher, flush function is
+ *        called once more before return
+ * @param pflusher - flusher handle
+ */
+void flusher_free(flusher *pflusher)
+{
+    T_ASSERT(NULL != pflusher);
+
+    pthread_mutex_lock(&pflusher->mutex);
+    pflusher->running = FALSE;
+    pthread_cond_signal(&pflusher->cond);
+    pthread_mutex_unlock(&pflusher->mutex);
+    pthread_join(pflusher->thread, NULL);
+
+    pthread_cond_destroy(&pflusher->cond);
+    pthread_mutex_destroy(&pflusher->mutex);
+    free(pflusher);
+}
+
+/**
+ * @brief wake flusher thread to flush now
+ * @param pflusher - flusher handle
+ */
+void flusher_kick(flusher *pflusher)
+{
+    T_ASSERT(NULL != pflusher);
+
+    pthread_mutex_lock(&pflusher->mutex);
+    pflusher->kicked = TRUE;
+    pthread_cond_signal(&pflusher->cond);
+    pthread_mutex_unlock(&pflusher->mutex);
+}
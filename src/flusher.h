@@ -0,0 +1,27 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _FLUSHER_H_
+#define _FLUSHER_H_
+
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+typedef struct _flusher flusher;
+
+/* flush function, called in flusher thread */
+typedef void (*flusher_func)(void *userdata);
+
+/* flusher interface */
+T_EXTERN flusher *flusher_new(tuint32 interval_ms, flusher_func func, void *userdata);
+T_EXTERN void flusher_free(flusher *pflusher);
+T_EXTERN void flusher_kick(flusher *pflusher);
+
+T_END_DECLS
+
+#endif /* _FLUSHER_H_ */
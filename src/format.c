@@ -14,29 +14,68 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "format.h"
 #include "tassert.h"
 #include "tstring.h"
 #include "thash_string.h"
 #include "global.h"
 #include "level.h"
+#include "argpack.h"
+#include "timestamp.h"
 
 
 
 /****************************************************
  * macros definition
  ****************************************************/
-#define SPLIT_MAX_LEN 99
+#define SPLIT_MAX_LEN TIMESTAMP_MAX_LEN
 
 
 /****************************************************
  * struct definition
  ****************************************************/
+/* split type, dispatched in format_split_to_string */
+typedef enum
+{
+    SPLIT_NONE,
+    SPLIT_LITERAL,
+    SPLIT_TIME,
+    SPLIT_TIME_ISO,
+    SPLIT_TIME_MS,
+    SPLIT_TIME_US,
+    SPLIT_TIME_NS,
+    SPLIT_TIME_EPOCH,
+    SPLIT_UPTIME,
+    SPLIT_FILENAME,
+    SPLIT_FILENAME_FULL,
+    SPLIT_LINE,
+    SPLIT_FUNCTION,
+    SPLIT_MESSAGE,
+    SPLIT_MESSAGE_SAFE,
+    SPLIT_LEVEL_UPPER,
+    SPLIT_LEVEL_LOWER,
+    SPLIT_TID_HEX,
+    SPLIT_TID,
+    SPLIT_KTID,
+    SPLIT_THREAD_NAME,
+    SPLIT_PID,
+    SPLIT_CATEGORY,
+    SPLIT_FIELDS_LOGFMT,
+    SPLIT_FIELDS_JSON,
+    SPLIT_MDC,
+    SPLIT_JSON_RECORD,
+}split_type;
+
 /* split format */
 typedef struct _split_format_single split_format_single;
 
-typedef tuint32 (*splitformat_write)(tchar *buf, split_format_single *split_single, const preprocess_info *pre);
-
+/* read only after format_to_split, record values come from preprocess_info */
 struct _split_format_single
 {
     tchar *data;
@@ -48,9 +87,11 @@ struct _split_format_single
     tuint8 width_min;
     /* -1: unlimit */
     tint8 width_max;
-    splitformat_write write_buf;
-
-    pthread_mutex_t *mutex;
+    tuint8 type;
+    /* literal length */
+    tuint32 len;
+    /* timestamp cache id */
+    tuint32 id;
 };
 
 struct _split_format
@@ -83,6 +124,9 @@ static tchar *upper_level[] =
     "FATAL"
 };
 
+/* level string length map */
+static const tuint8 level_len[] = {5, 4, 6, 4, 5, 5};
+
 /* level lower string map */
 static tchar *lower_level[] = 
 {
@@ -99,445 +143,1093 @@ static tchar *lower_level[] =
  * functions 
  ****************************************************/
 /**
- * @brief write alignment data to buffer
+ * @brief append alignment data to buffer
+ * @param buf - output buffer
  * @param split_single - split handle
+ * @param data - data to write
+ * @param data_len - data length
  * @return success written length
  */
-static tuint32 align_write(tchar *buf, const split_format_single *split_single)
+static inline tuint32 align_write(tbuffer *buf, const split_format_single *split_single,
+        const tchar *data, tuint32 data_len)
 {
-    if (NULL == split_single->data)
+    if ((0 == split_single->width_min) && (split_single->width_max < 0))
+    {
+        return (0 == t_buffer_append(buf, data, data_len)) ? data_len : 0;
+    }
+
+    if ((split_single->width_max >= 0) && 
+        (data_len > (tuint32)split_single->width_max))
+    {
+        T_ASSERT(split_single->width_max >= split_single->width_min);
+        data_len = split_single->width_max;
+    }
+
+    tuint32 pad_len = 0;
+    if (data_len < split_single->width_min)
+    {
+        pad_len = split_single->width_min - data_len;
+    }
+
+    if (0 != t_buffer_reserve(buf, data_len + pad_len))
     {
         return 0;
     }
 
-    tint data_len = strlen(split_single->data);
-    tint valid_buf_len = -1;
+    tchar *pos = buf->data + buf->len;
+    if (1 == split_single->align)
+    {
+        /* left alignment */
+        memcpy(pos, data, data_len);
+        memset(pos + data_len, ' ', pad_len);
+    }
+    else
+    {
+        /* right alignment */
+        memset(pos, ' ', pad_len);
+        memcpy(pos + pad_len, data, data_len);
+    }
+    buf->len += data_len + pad_len;
+    buf->data[buf->len] = '\0';
+
+    return data_len + pad_len;
+}
 
-    if (split_single->width_max >= 0)
+/**
+ * @brief append alignment string to buffer
+ * @param buf - output buffer
+ * @param split_single - split handle
+ * @param str - string to write, NULL means nothing
+ * @return success written length
+ */
+static tuint32 align_write_str(tbuffer *buf, const split_format_single *split_single,
+        const tchar *str)
+{
+    if (NULL == str)
     {
-        T_ASSERT(split_single->width_max >= split_single->width_min);
-        if (data_len > split_single->width_max)
+        return 0;
+    }
+
+    return align_write(buf, split_single, str, strlen(str));
+}
+
+/**
+ * @brief write data direct to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_direct(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    return align_write(buf, split_single, split_single->data, split_single->len);
+}
+
+/**
+ * @brief write current time to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tuint32 len = 0;
+    const tchar *text = timestamp_render(split_single->id, split_single->data,
+            pre->ts.tv_sec, &len);
+    tchar temp_buf[SPLIT_MAX_LEN + 1];
+    if (NULL == text)
+    {
+        /* no cache, render directly */
+        time_t lt = pre->ts.tv_sec;
+        struct tm ltm;
+        if (NULL == localtime_r(&lt, &ltm))
         {
-            valid_buf_len = split_single->width_max;
+            return 0;
         }
-        else
-        {
+        len = strftime(temp_buf, SPLIT_MAX_LEN, split_single->data, &ltm);
+        temp_buf[len] = '\0';
+        text = temp_buf;
+    }
 
-            if (data_len < split_single->width_min)
-            {
-                valid_buf_len = split_single->width_min;
-            }
-            else
-            {
-                valid_buf_len = data_len;
-            }
-        }
+    return align_write(buf, split_single, text, len);
+}
+
+/**
+ * @brief render utc time in iso-8601 format with millisecond,
+ *        e.g. 2017-01-02T03:04:05.678Z
+ * @param temp_buf - output buffer, at least TIMESTAMP_ISO_LEN + 6 bytes
+ * @param pre - preprocess information handle
+ * @return rendered length
+ */
+static tuint32 render_time_iso(tchar *temp_buf, const preprocess_info *pre)
+{
+    timestamp_iso_utc(pre->ts.tv_sec, temp_buf);
+    tuint32 ms = pre->ts.tv_nsec / 1000000;
+    temp_buf[TIMESTAMP_ISO_LEN] = '.';
+    temp_buf[TIMESTAMP_ISO_LEN + 1] = ms / 100 + '0';
+    temp_buf[TIMESTAMP_ISO_LEN + 2] = ms / 10 % 10 + '0';
+    temp_buf[TIMESTAMP_ISO_LEN + 3] = ms % 10 + '0';
+    temp_buf[TIMESTAMP_ISO_LEN + 4] = 'Z';
+    temp_buf[TIMESTAMP_ISO_LEN + 5] = '\0';
+
+    return TIMESTAMP_ISO_LEN + 5;
+}
+
+/**
+ * @brief write utc time in iso-8601 format with millisecond to buffer,
+ *        e.g. 2017-01-02T03:04:05.678Z
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time_iso(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tchar temp_buf[TIMESTAMP_ISO_LEN + 6];
+    tuint32 len = render_time_iso(temp_buf, pre);
+
+    return align_write(buf, split_single, temp_buf, len);
+}
+
+/**
+ * @brief write millsecond time to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time_ms(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tchar temp_buf[4];
+    tuint32 ms = pre->ts.tv_nsec / 1000000;
+    temp_buf[0] = ms / 100 + '0';
+    temp_buf[1] = ms / 10 % 10 + '0';
+    temp_buf[2] = ms % 10+ '0';
+    temp_buf[3] = '\0';
+    return (0 == t_buffer_append(buf, temp_buf, 3)) ? 3 : 0;
+}
+
+/**
+ * @brief write microsecond time to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time_us(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tchar temp_buf[7];
+    tuint32 us = pre->ts.tv_nsec / 1000;
+    temp_buf[0] = us / 100000 + '0';
+    temp_buf[1] = us / 10000 % 10 + '0';
+    temp_buf[2] = us / 1000 % 10 + '0';
+    temp_buf[3] = us / 100 % 10 + '0';
+    temp_buf[4] = us / 10 % 10 + '0';
+    temp_buf[5] = us % 10 + '0';
+    temp_buf[6] = '\0';
+    return (0 == t_buffer_append(buf, temp_buf, 6)) ? 6 : 0;
+}
+
+
+/**
+ * @brief render fixed 9 digits nanosecond
+ * @param buf - output buffer, at least 9 bytes
+ * @param nsec - nanosecond, 0 - 999999999
+ */
+static inline void put_nsec(tchar *buf, tuint32 nsec)
+{
+    for (tint i = 8; i >= 0; --i)
+    {
+        buf[i] = nsec % 10 + '0';
+        nsec /= 10;
+    }
+}
+
+/**
+ * @brief write nanosecond time to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time_ns(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tchar temp_buf[10];
+    put_nsec(temp_buf, pre->ts.tv_nsec);
+    temp_buf[9] = '\0';
+    return (0 == t_buffer_append(buf, temp_buf, 9)) ? 9 : 0;
+}
+
+/**
+ * @brief write time as seconds with 9 digits fraction, e.g. 1500000000.123456789
+ * @param split_single - split handle
+ * @param ts - time
+ * @return success written length
+ */
+static tuint32 write_seconds_ns(tbuffer *buf, const split_format_single *split_single,
+        const struct timespec *ts)
+{
+    tchar temp_buf[32];
+    tuint32 len = t_string_from_int(temp_buf, ts->tv_sec);
+    temp_buf[len] = '.';
+    put_nsec(temp_buf + len + 1, ts->tv_nsec);
+    len += 10;
+    temp_buf[len] = '\0';
+
+    return align_write(buf, split_single, temp_buf, len);
+}
+
+/**
+ * @brief write seconds since epoch with nanosecond to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_time_epoch(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    return write_seconds_ns(buf, split_single, &pre->ts);
+}
+
+/**
+ * @brief write monotonic time since tlog_open with nanosecond to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_uptime(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    return write_seconds_ns(buf, split_single, &pre->uptime);
+}
+
+/**
+ * @brief get short filename of call site
+ * @param pre - preprocess information handle
+ * @return short filename, NULL means no file
+ */
+static const tchar *get_filename(const preprocess_info *pre)
+{
+    if (NULL == pre->site->file)
+    {
+        return NULL;
     }
-    else if(split_single->width_min > 0)
+
+    /* compiler does not provide file name, find it at runtime */
+    const tchar *filename = pre->site->filename;
+    if (NULL == filename)
     {
-        if (data_len < split_single->width_min)
+        tint index = t_string_find_char_reverse(pre->site->file,
+                strlen(pre->site->file) - 1, '/', TRUE);
+        if (-1 != index)
         {
-            valid_buf_len = split_single->width_min;
+            filename = pre->site->file + index + 1;
         }
         else
         {
-            valid_buf_len = data_len;
+            filename = pre->site->file;
         }
     }
-    else
+
+    return filename;
+}
+
+/**
+ * @brief write short filename to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_filename(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    const tchar *filename = get_filename(pre);
+    if (NULL == filename)
     {
-        strcpy(buf, split_single->data);
-        return data_len;
+        return 0;
     }
 
-    /* align data */
-    if (data_len < valid_buf_len)
+    return align_write(buf, split_single, filename, strlen(filename));
+}
+
+/**
+ * @brief write full filename to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_filename_full(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    return align_write_str(buf, split_single, pre->site->file);
+}
+
+/**
+ * @brief write line data to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_line(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    tchar line[24];
+    tuint32 len = t_string_from_int(line, pre->site->line);
+    return align_write(buf, split_single, line, len);
+}
+
+/**
+ * @brief write function string to buffer
+ * @param split_single - split handle
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 write_function(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre)
+{
+    return align_write_str(buf, split_single, pre->site->func);
+}
+
+
+/**
+ * @brief render user message and append to buffer
+ * @param buf - output buffer
+ * @param pre - preprocess information handle
+ * @return success written length
+ */
+static tuint32 render_message(tbuffer *buf, const preprocess_info *pre)
+{
+    tuint32 start = buf->len;
+
+    if (NULL != pre->packed)
     {
-        if (split_single->align == 1)
+        /* render into free space, grow to exact size if not enough */
+        if (0 != t_buffer_reserve(buf, 0))
         {
-            /* left alignment */
-            strncpy(buf, split_single->data, data_len);
-            for (tuint32 i = data_len; i < valid_buf_len; ++i)
-            {
-                buf[i] = ' ';
-            }
+            return 0;
         }
-        else
+        tint len = argpack_render(buf->data + buf->len, buf->size - buf->len,
+                pre->fmt, pre->packed, pre->packed_len);
+        if (len <= 0)
         {
-            /* right alignment */
-            for (tuint32 i = 0; i < valid_buf_len - data_len; ++i)
+            buf->data[buf->len] = '\0';
+            return 0;
+        }
+        if ((tuint32)len >= buf->size - buf->len)
+        {
+            if (0 != t_buffer_reserve(buf, len))
             {
-                buf[i] = ' ';
+                buf->data[buf->len] = '\0';
+                return 0;
             }
-            strncpy(buf + valid_buf_len - data_len, split_single->data, data_len);
+            argpack_render(buf->data + buf->len, buf->size - buf->len,
+                    pre->fmt, pre->packed, pre->packed_len);
         }
+        buf->len += len;
     }
-    else
+    else if (NULL != pre->args)
     {
-        strncpy(buf, split_single->data, valid_buf_len);
+        t_buffer_vprintf(buf, pre->fmt, *pre->args);
     }
 
-    buf[valid_buf_len] = '\0';
-    return valid_buf_len;
+    return buf->len - start;
 }
 
 /**
- * @brief write data direct to buffer
+ * @brief write user message to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_direct(tchar *buf, split_format_single *split_single,
+static tuint32 write_message(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    return align_write(buf, split_single); 
+    if (NULL != pre->user_msg)
+    {
+        return align_write_str(buf, split_single, pre->user_msg);
+    }
+
+    /* no width constraints, render directly into record */
+    if ((0 == split_single->width_min) && (split_single->width_max < 0))
+    {
+        return render_message(buf, pre);
+    }
+
+    T_ASSERT(NULL != pre->msg_buf);
+    t_buffer_clear(pre->msg_buf);
+    render_message(pre->msg_buf, pre);
+
+    return align_write(buf, split_single, pre->msg_buf->data, pre->msg_buf->len);
 }
 
 /**
- * @brief write current time to buffer
+ * @brief find first control character or one of two special characters,
+ *        clean blocks are skipped 16 or 32 bytes at a time
+ * @param str - string
+ * @param pos - start position
+ * @param len - string length
+ * @param special1 - special character
+ * @param special2 - special character
+ * @return position of first character to escape, len means none
+ */
+static inline tuint32 escape_scan(const tchar *str, tuint32 pos, tuint32 len,
+        tchar special1, tchar special2)
+{
+#if defined(__AVX2__)
+    const __m256i special1_32 = _mm256_set1_epi8(special1);
+    const __m256i special2_32 = _mm256_set1_epi8(special2);
+    const __m256i ctrl32 = _mm256_set1_epi8(0x1f);
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(str + pos));
+        /* unsigned c <= 0x1f if max(c, 0x1f) == 0x1f */
+        __m256i hit = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, special1_32),
+                    _mm256_cmpeq_epi8(block, special2_32)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(block, ctrl32), ctrl32));
+        tuint32 mask = (tuint32)_mm256_movemask_epi8(hit);
+        if (0 != mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i special1_16 = _mm_set1_epi8(special1);
+    const __m128i special2_16 = _mm_set1_epi8(special2);
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(str + pos));
+        __m128i hit = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, special1_16),
+                    _mm_cmpeq_epi8(block, special2_16)),
+                _mm_cmpeq_epi8(_mm_max_epu8(block, ctrl), ctrl));
+        tuint32 mask = (tuint32)_mm_movemask_epi8(hit);
+        if (0 != mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; pos < len; ++pos)
+    {
+        tchar c = str[pos];
+        if (((tuchar)c < 0x20) || (special1 == c) || (special2 == c))
+        {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * @brief find first character which must be escaped in json string
+ * @param str - string
+ * @param pos - start position
+ * @param len - string length
+ * @return position of first character to escape, len means none
+ */
+static inline tuint32 json_scan(const tchar *str, tuint32 pos, tuint32 len)
+{
+    return escape_scan(str, pos, len, '"', '\\');
+}
+
+/**
+ * @brief find first control character, include DEL
+ * @param str - string
+ * @param pos - start position
+ * @param len - string length
+ * @return position of first control character, len means none
+ */
+static inline tuint32 ctrl_scan(const tchar *str, tuint32 pos, tuint32 len)
+{
+    return escape_scan(str, pos, len, 0x7f, 0x7f);
+}
+
+/**
+ * @brief append json string with quotes and escape
+ * @param buf - output buffer
+ * @param str - string
+ * @param len - string length
+ */
+static void append_json_string(tbuffer *buf, const tchar *str, tuint32 len)
+{
+    static const tchar hex[] = "0123456789abcdef";
+    tchar esc[6] = {'\\', 'u', '0', '0', 0, 0};
+
+    /* most strings have nothing to escape */
+    if (0 != t_buffer_reserve(buf, len + 2))
+    {
+        return ;
+    }
+
+    t_buffer_append_char(buf, '"', 1);
+    tuint32 start = 0;
+    tuint32 pos = json_scan(str, 0, len);
+    while (pos < len)
+    {
+        t_buffer_append(buf, str + start, pos - start);
+        tuchar c = (tuchar)str[pos];
+        switch (c)
+        {
+        case '"':
+            t_buffer_append(buf, "\\\"", 2);
+            break;
+        case '\\':
+            t_buffer_append(buf, "\\\\", 2);
+            break;
+        case '\n':
+            t_buffer_append(buf, "\\n", 2);
+            break;
+        case '\r':
+            t_buffer_append(buf, "\\r", 2);
+            break;
+        case '\t':
+            t_buffer_append(buf, "\\t", 2);
+            break;
+        default:
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0x0f];
+            t_buffer_append(buf, esc, 6);
+            break;
+        }
+        start = pos + 1;
+        pos = json_scan(str, start, len);
+    }
+    t_buffer_append(buf, str + start, len - start);
+    t_buffer_append_char(buf, '"', 1);
+}
+
+/**
+ * @brief append string with control characters escaped, so record
+ *        always stays in one line, e.g. "\n" -> "\\n", ESC -> "\\x1b"
+ * @param buf - output buffer
+ * @param str - string
+ * @param len - string length
+ */
+static void append_sanitized(tbuffer *buf, const tchar *str, tuint32 len)
+{
+    static const tchar hex[] = "0123456789abcdef";
+    tchar esc[4] = {'\\', 'x', 0, 0};
+
+    if (0 != t_buffer_reserve(buf, len))
+    {
+        return ;
+    }
+
+    tuint32 start = 0;
+    tuint32 pos = ctrl_scan(str, 0, len);
+    while (pos < len)
+    {
+        t_buffer_append(buf, str + start, pos - start);
+        tuchar c = (tuchar)str[pos];
+        switch (c)
+        {
+        case '\n':
+            t_buffer_append(buf, "\\n", 2);
+            break;
+        case '\r':
+            t_buffer_append(buf, "\\r", 2);
+            break;
+        case '\t':
+            t_buffer_append(buf, "\\t", 2);
+            break;
+        default:
+            esc[2] = hex[c >> 4];
+            esc[3] = hex[c & 0x0f];
+            t_buffer_append(buf, esc, 4);
+            break;
+        }
+        start = pos + 1;
+        pos = ctrl_scan(str, start, len);
+    }
+    t_buffer_append(buf, str + start, len - start);
+}
+
+/**
+ * @brief write user message with control characters escaped to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_time(tchar *buf, split_format_single *split_single,
+static tuint32 write_message_safe(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    time_t lt = time(NULL);
-    struct tm ltm;
-    if (NULL == localtime_r(&lt, &ltm))
+    tbool unlimit = (0 == split_single->width_min) && (split_single->width_max < 0);
+    tuint32 start = buf->len;
+
+    if (NULL != pre->user_msg)
+    {
+        if (unlimit)
+        {
+            append_sanitized(buf, pre->user_msg, strlen(pre->user_msg));
+            return buf->len - start;
+        }
+
+        T_ASSERT(NULL != pre->msg_buf);
+        t_buffer_clear(pre->msg_buf);
+        append_sanitized(pre->msg_buf, pre->user_msg, strlen(pre->user_msg));
+        return align_write(buf, split_single, pre->msg_buf->data, pre->msg_buf->len);
+    }
+
+    T_ASSERT(NULL != pre->msg_buf);
+    if (unlimit)
+    {
+        /* render directly into record, only the dirty tail is moved */
+        tuint32 len = render_message(buf, pre);
+        tuint32 pos = ctrl_scan(buf->data + start, 0, len);
+        if (pos < len)
+        {
+            t_buffer_clear(pre->msg_buf);
+            t_buffer_append(pre->msg_buf, buf->data + start + pos, len - pos);
+            buf->len = start + pos;
+            append_sanitized(buf, pre->msg_buf->data, pre->msg_buf->len);
+        }
+        return buf->len - start;
+    }
+
+    t_buffer_clear(pre->msg_buf);
+    tuint32 len = render_message(pre->msg_buf, pre);
+    if (ctrl_scan(pre->msg_buf->data, 0, len) == len)
+    {
+        return align_write(buf, split_single, pre->msg_buf->data, len);
+    }
+
+    /* escaped message follows raw message, at most 4 bytes each */
+    if ((len > 0x3fffffffu) || (0 != t_buffer_reserve(pre->msg_buf, len * 4)))
     {
         return 0;
     }
-    tuint32 retlen = 0;
+    append_sanitized(pre->msg_buf, pre->msg_buf->data, len);
+
+    return align_write(buf, split_single, pre->msg_buf->data + len,
+            pre->msg_buf->len - len);
+}
+
+/**
+ * @brief append logfmt value, quote it if necessary
+ * @param buf - output buffer
+ * @param str - string
+ */
+static void append_logfmt_string(tbuffer *buf, const tchar *str)
+{
+    const tchar *pos = str;
+    for (; '\0' != *pos; ++pos)
+    {
+        if (((tuchar)*pos <= ' ') || ('=' == *pos) || ('"' == *pos) || 
+            ('\\' == *pos))
+        {
+            break;
+        }
+    }
 
-    if ((split_single->width_min > 0) || 
-        (split_single->width_max >= 0))
+    if ((pos == str) || ('\0' != *pos))
     {
-        tchar temp_buf[SPLIT_MAX_LEN + 1];
-        pthread_mutex_lock(split_single->mutex);
-        tchar *tmp = split_single->data;
-        strftime(temp_buf, SPLIT_MAX_LEN, split_single->data, &ltm);
-        temp_buf[SPLIT_MAX_LEN] = '\0';
-        split_single->data = temp_buf;
-        retlen = align_write(buf, split_single);
-        split_single->data = tmp;
-        pthread_mutex_unlock(split_single->mutex);
+        append_json_string(buf, str, strlen(str));
     }
     else
     {
-        pthread_mutex_lock(split_single->mutex);
-        retlen = strftime(buf, SPLIT_MAX_LEN, split_single->data, &ltm);
-        pthread_mutex_unlock(split_single->mutex);
+        t_buffer_append(buf, str, pos - str);
     }
+}
 
-    return retlen;
+/**
+ * @brief append structured field value
+ * @param buf - output buffer
+ * @param field - field
+ * @param json - TRUE: json value, FALSE: logfmt value
+ */
+static void append_field_value(tbuffer *buf, const tlog_field *field, tbool json)
+{
+    tchar num[32];
+    tuint32 len = 0;
+
+    switch (field->type)
+    {
+    case TLOG_FIELD_STR:
+    {
+        const tchar *str = (NULL != field->value.s) ? field->value.s : "";
+        if (json)
+        {
+            append_json_string(buf, str, strlen(str));
+        }
+        else
+        {
+            append_logfmt_string(buf, str);
+        }
+        return;
+    }
+    case TLOG_FIELD_INT:
+        len = t_string_from_int(num, field->value.i);
+        break;
+    case TLOG_FIELD_UINT:
+        len = t_string_from_uint(num, field->value.u);
+        break;
+    case TLOG_FIELD_DOUBLE:
+        if (isnan(field->value.d))
+        {
+            len = snprintf(num, sizeof(num), "%s", json ? "null" : "nan");
+        }
+        else if (isinf(field->value.d))
+        {
+            len = snprintf(num, sizeof(num), "%s", json ? "null" :
+                    ((field->value.d > 0) ? "inf" : "-inf"));
+        }
+        else
+        {
+            /* shortest precision that converts back to the same value */
+            len = snprintf(num, sizeof(num), "%.15g", field->value.d);
+            if (strtod(num, NULL) != field->value.d)
+            {
+                len = snprintf(num, sizeof(num), "%.17g", field->value.d);
+            }
+        }
+        break;
+    case TLOG_FIELD_BOOL:
+        len = snprintf(num, sizeof(num), "%s", field->value.i ? "true" : "false");
+        break;
+    default:
+        T_ASSERT(FALSE);
+        return;
+    }
+
+    t_buffer_append(buf, num, len);
 }
 
 /**
- * @brief write millsecond time to buffer
- * @param split_single - split handle
+ * @brief render structured fields and append to buffer
+ * @param buf - output buffer
  * @param pre - preprocess information handle
- * @return success written length
+ * @param json - TRUE: json object, FALSE: logfmt
  */
-static tuint32 write_time_ms(tchar *buf, split_format_single *split_single,
-        const preprocess_info *pre)
+static void render_fields(tbuffer *buf, const preprocess_info *pre, tbool json)
 {
-    struct timeval tv;
-    if (0 == gettimeofday(&tv, NULL))
+    if (json)
     {
-        tchar temp_buf[4];
-        tuint32 ms = tv.tv_usec / 1000;
-        temp_buf[0] = ms / 100 + '0';
-        temp_buf[1] = ms / 10 % 10 + '0';
-        temp_buf[2] = ms % 10+ '0';
-        temp_buf[3] = '\0';
-        strcpy(buf, temp_buf);
-        return 3;
+        t_buffer_append_char(buf, '{', 1);
     }
 
-    return 0;
+    for (tuint32 i = 0; i < pre->field_count; ++i)
+    {
+        const tlog_field *field = &pre->fields[i];
+        const tchar *key = (NULL != field->key) ? field->key : "";
+        if (i > 0)
+        {
+            t_buffer_append_char(buf, json ? ',' : ' ', 1);
+        }
+
+        if (json)
+        {
+            append_json_string(buf, key, strlen(key));
+            t_buffer_append_char(buf, ':', 1);
+        }
+        else
+        {
+            t_buffer_append(buf, key, strlen(key));
+            t_buffer_append_char(buf, '=', 1);
+        }
+        append_field_value(buf, field, json);
+    }
+
+    if (json)
+    {
+        t_buffer_append_char(buf, '}', 1);
+    }
 }
 
 /**
- * @brief write microsecond time to buffer
+ * @brief write structured fields to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
+ * @param json - TRUE: json object, FALSE: logfmt
  * @return success written length
  */
-static tuint32 write_time_us(tchar *buf, split_format_single *split_single,
-        const preprocess_info *pre)
+static tuint32 write_fields(tbuffer *buf, const split_format_single *split_single,
+        const preprocess_info *pre, tbool json)
 {
-    struct timeval tv;
-    if (0 == gettimeofday(&tv, NULL))
+    tuint32 start = buf->len;
+
+    /* no width constraints, render directly into record */
+    if ((0 == split_single->width_min) && (split_single->width_max < 0))
     {
-        tchar temp_buf[7];
-        temp_buf[0] = tv.tv_usec / 100000 + '0';
-        temp_buf[1] = tv.tv_usec / 10000 % 10 + '0';
-        temp_buf[2] = tv.tv_usec / 1000 % 10 + '0';
-        temp_buf[3] = tv.tv_usec / 100 % 10 + '0';
-        temp_buf[4] = tv.tv_usec / 10 % 10 + '0';
-        temp_buf[5] = tv.tv_usec % 10 + '0';
-        temp_buf[6] = '\0';
-        strcpy(buf, temp_buf);
-        return 6;
+        render_fields(buf, pre, json);
+        return buf->len - start;
     }
 
-    return 0;
-}
-
+    T_ASSERT(NULL != pre->msg_buf);
+    t_buffer_clear(pre->msg_buf);
+    render_fields(pre->msg_buf, pre, json);
 
+    return align_write(buf, split_single, pre->msg_buf->data, pre->msg_buf->len);
+}
 
 /**
- * @brief write short filename to buffer
+ * @brief write structured fields as logfmt to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_filename(tchar *buf, split_format_single *split_single,
+static tuint32 write_fields_logfmt(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    if (NULL == pre->file)
-    {
-        return 0;
-    }
-
-    tuint32 retlen = 0;
-
-    const tchar *filename = NULL;
-    tint index = t_string_find_char_reverse(pre->file, strlen(pre->file) - 1, '/', TRUE);
-    if (-1 != index)
-    {
-        filename = pre->file + index + 1;
-    }
-    else
-    {
-        filename = pre->file;
-    }
-
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = (tchar *)filename;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
-
-    return retlen;
+    return write_fields(buf, split_single, pre, FALSE);
 }
 
 /**
- * @brief write full filename to buffer
+ * @brief write structured fields as json object to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_filename_full(tchar *buf, split_format_single *split_single,
+static tuint32 write_fields_json(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = (tchar *)pre->file;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
-
-    return retlen;
+    return write_fields(buf, split_single, pre, TRUE);
 }
 
 /**
- * @brief write line data to buffer
+ * @brief write lower level data to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_line(tchar *buf, split_format_single *split_single,
+static tuint32 write_level_lower(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
     tuint32 retlen = 0;
 
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = (tchar *)pre->line_str;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    T_ASSERT((pre->site->level & LEVEL_INDEX_MASK) < 6);
+
+    retlen = align_write(buf, split_single, lower_level[pre->site->level & LEVEL_INDEX_MASK],
+            level_len[pre->site->level & LEVEL_INDEX_MASK]);
 
     return retlen;
 }
 
 /**
- * @brief write function string to buffer
+ * @brief write upper level data to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_function(tchar *buf, split_format_single *split_single,
+static tuint32 write_level_upper(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
     tuint32 retlen = 0;
 
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = (tchar *)pre->func;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    T_ASSERT((pre->site->level & LEVEL_INDEX_MASK) < 6);
+
+    retlen = align_write(buf, split_single, upper_level[pre->site->level & LEVEL_INDEX_MASK],
+            level_len[pre->site->level & LEVEL_INDEX_MASK]);
 
     return retlen;
 }
 
+/**
+ * @brief get thread identity of record
+ * @param pre - preprocess information handle
+ * @return thread identity, NULL means no memory
+ */
+static inline const thread_identity *get_identity(const preprocess_info *pre)
+{
+    return (NULL != pre->ident) ? pre->ident : identity_current();
+}
 
 /**
- * @brief write user message to buffer
+ * @brief write thread id
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_message(tchar *buf, split_format_single *split_single,
+static tuint32 write_tid(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = (tchar *)pre->user_msg;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    const thread_identity *ident = get_identity(pre);
+    if (NULL == ident)
+    {
+        return 0;
+    }
 
-    return retlen;
+    return align_write(buf, split_single, ident->tid_str, ident->tid_len);
 }
 
 /**
- * @brief write lower level data to buffer
+ * @brief write hexadecimal thread id
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_level_lower(tchar *buf, split_format_single *split_single,
+static tuint32 write_tid_hex(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    T_ASSERT((pre->level & LEVEL_INDEX_MASK) < 6);
-
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = lower_level[pre->level & LEVEL_INDEX_MASK];
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    const thread_identity *ident = get_identity(pre);
+    if (NULL == ident)
+    {
+        return 0;
+    }
 
-    return retlen;
+    return align_write(buf, split_single, ident->tid_hex_str, ident->tid_hex_len);
 }
 
 /**
- * @brief write upper level data to buffer
+ * @brief write kernel thread id
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_level_upper(tchar *buf, split_format_single *split_single,
+static tuint32 write_ktid(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    T_ASSERT((pre->level & LEVEL_INDEX_MASK) < 6);
-
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = upper_level[pre->level & LEVEL_INDEX_MASK];
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    const thread_identity *ident = get_identity(pre);
+    if (NULL == ident)
+    {
+        return 0;
+    }
 
-    return retlen;
+    return align_write(buf, split_single, ident->ktid_str, ident->ktid_len);
 }
 
 /**
- * @brief write thread id
+ * @brief write thread name
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_tid(tchar *buf, split_format_single *split_single,
+static tuint32 write_thread_name(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    tchar tid[24];
-    pthread_t id = pthread_self();
-    sprintf(tid, "%lu", (tulong)id);
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = tid;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    const thread_identity *ident = get_identity(pre);
+    if (NULL == ident)
+    {
+        return 0;
+    }
 
-    return retlen;
+    return align_write(buf, split_single, ident->name, ident->name_len);
 }
 
 /**
- * @brief write upper level data to buffer
+ * @brief write process id
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_tid_hex(tchar *buf, split_format_single *split_single,
+static tuint32 write_pid(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-
-    tchar tid[24];
-    pthread_t id = pthread_self();
-    sprintf(tid, "0x%lx", (tulong)id);
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = tid;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
+    const thread_identity *ident = get_identity(pre);
+    if (NULL == ident)
+    {
+        return 0;
+    }
 
-    return retlen;
+    return align_write(buf, split_single, ident->pid_str, ident->pid_len);
 }
 
 /**
- * @brief write upper level data to buffer
+ * @brief write mdc info to buffer
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_pid(tchar *buf, split_format_single *split_single,
+static tuint32 write_mdc(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
     tuint32 retlen = 0;
+    if (NULL == pre->mdc_handle)
+    {
+        return 0;
+    }
 
-    tchar pid[24];
-    pid_t id = getpid();
-    sprintf(pid, "%lu", (tulong)id);
-    pthread_mutex_lock(split_single->mutex);
-    split_single->data = pid;
-    retlen = align_write(buf, split_single);
-    split_single->data = NULL;
-    pthread_mutex_unlock(split_single->mutex);
-
+    tchar *val = mdc_get(pre->mdc_handle, split_single->data);
+    if (NULL != val)
+    {
+        retlen = align_write_str(buf, split_single, val);
+    }
     return retlen;
 }
 
 /**
- * @brief write mdc info to buffer
+ * @brief append mdc key-value as json object member
+ * @param key - mdc key
+ * @param value - mdc value
+ * @param userdata - output buffer
+ */
+static void append_json_mdc(const tchar *key, const tchar *value, void *userdata)
+{
+    tbuffer *buf = (tbuffer *)userdata;
+    t_buffer_append_char(buf, ',', 1);
+    append_json_string(buf, key, strlen(key));
+    t_buffer_append_char(buf, ':', 1);
+    append_json_string(buf, value, strlen(value));
+}
+
+/**
+ * @brief write whole record as one json object, width constraints are
+ *        ignored
  * @param split_single - split handle
  * @param pre - preprocess information handle
  * @return success written length
  */
-static tuint32 write_mdc(tchar *buf, split_format_single *split_single,
+static tuint32 write_json_record(tbuffer *buf, const split_format_single *split_single,
         const preprocess_info *pre)
 {
-    tuint32 retlen = 0;
-    pthread_mutex_lock(split_single->mutex);
-    tchar *val = mdc_get(pre->mdc_handle, split_single->data);
-    if (NULL != val)
+    tuint32 start = buf->len;
+    tchar temp_buf[TIMESTAMP_ISO_LEN + 6];
+    tuint32 level = pre->site->level & LEVEL_INDEX_MASK;
+    (void)split_single;
+
+    T_ASSERT(level < 6);
+
+    t_buffer_append(buf, "{\"time\":\"", 9);
+    t_buffer_append(buf, temp_buf, render_time_iso(temp_buf, pre));
+    t_buffer_append(buf, "\",\"level\":\"", 11);
+    t_buffer_append(buf, upper_level[level], level_len[level]);
+    t_buffer_append(buf, "\",\"file\":", 9);
+    const tchar *filename = get_filename(pre);
+    if (NULL == filename)
     {
-        tchar *tmp = split_single->data;
-        split_single->data = val;
-        retlen = align_write(buf, split_single);
-        split_single->data = tmp;
+        filename = "";
     }
-    pthread_mutex_unlock(split_single->mutex);
-    return retlen;
+    append_json_string(buf, filename, strlen(filename));
+    t_buffer_append(buf, ",\"line\":", 8);
+    t_buffer_append(buf, temp_buf, t_string_from_int(temp_buf, pre->site->line));
+    t_buffer_append(buf, ",\"func\":", 8);
+    const tchar *func = (NULL != pre->site->func) ? pre->site->func : "";
+    append_json_string(buf, func, strlen(func));
+    t_buffer_append(buf, ",\"msg\":", 7);
+    if (NULL != pre->user_msg)
+    {
+        append_json_string(buf, pre->user_msg, strlen(pre->user_msg));
+    }
+    else
+    {
+        T_ASSERT(NULL != pre->msg_buf);
+        t_buffer_clear(pre->msg_buf);
+        render_message(pre->msg_buf, pre);
+        append_json_string(buf, pre->msg_buf->data, pre->msg_buf->len);
+    }
+
+    if (NULL != pre->mdc_handle)
+    {
+        mdc_foreach(pre->mdc_handle, append_json_mdc, buf);
+    }
+
+    /* structured fields are merged into record object */
+    for (tuint32 i = 0; i < pre->field_count; ++i)
+    {
+        const tlog_field *field = &pre->fields[i];
+        const tchar *key = (NULL != field->key) ? field->key : "";
+        t_buffer_append_char(buf, ',', 1);
+        append_json_string(buf, key, strlen(key));
+        t_buffer_append_char(buf, ':', 1);
+        append_field_value(buf, field, TRUE);
+    }
+    t_buffer_append_char(buf, '}', 1);
+
+    return buf->len - start;
 }
 
 /**
@@ -554,7 +1246,7 @@ thash_string *format_new(void)
  * @param split - split format handle
  * @param length - split format length
  */
-static void split_format_free(split_format *split)
+void split_format_free(split_format *split)
 {
     T_ASSERT(NULL != split);
     for (tuint32 i = 0; i < split->count; ++i)
@@ -562,8 +1254,6 @@ static void split_format_free(split_format *split)
         if (NULL != split->splits[i].data)
         {
             free(split->splits[i].data);
-            pthread_mutex_destroy(split->splits[i].mutex);
-            free(split->splits[i].mutex);
         }
     }
 
@@ -651,6 +1341,74 @@ const split_format *get_format_split(const thash_string *hash, const tchar *name
 }
 
 
+/**
+ * @brief check if split is literal without width constraints
+ * @param split - split handle
+ * @return TRUE: plain literal
+ */
+static tbool split_is_plain_literal(const split_format_single *split)
+{
+    return (SPLIT_LITERAL == split->type) && (0 == split->width_min) &&
+        (split->width_max < 0);
+}
+
+/**
+ * @brief compute literal lengths, merge adjacent plain literals and drop
+ *        empty splits, so every literal run is written by one copy
+ * @param splits - split format handle
+ * @return error code, 0 means no error
+ */
+static tint split_format_fuse(split_format *splits)
+{
+    tuint32 count = 0;
+    for (tuint32 i = 0; i < splits->count; ++i)
+    {
+        split_format_single *split = &splits->splits[i];
+        if (SPLIT_LITERAL == split->type)
+        {
+            split->len = strlen(split->data);
+        }
+
+        if ((SPLIT_NONE == split->type) ||
+            ((SPLIT_LITERAL == split->type) && (0 == split->len)))
+        {
+            free(split->data);
+            split->data = NULL;
+            continue;
+        }
+
+        split_format_single *last = (count > 0) ? &splits->splits[count - 1] : NULL;
+        if ((NULL != last) && split_is_plain_literal(last) &&
+            split_is_plain_literal(split))
+        {
+            tchar *data = malloc(last->len + split->len + 1);
+            if (NULL == data)
+            {
+                return -ENOMEM;
+            }
+            memcpy(data, last->data, last->len);
+            memcpy(data + last->len, split->data, split->len + 1);
+            free(last->data);
+            last->data = data;
+            last->len += split->len;
+            free(split->data);
+            split->data = NULL;
+            continue;
+        }
+
+        /* moved split no longer owns data */
+        if (i != count)
+        {
+            splits->splits[count] = *split;
+            split->data = NULL;
+        }
+        count++;
+    }
+    splits->count = count;
+
+    return 0;
+}
+
 /**
  * @brief split format quickly
  * @param format - format string
@@ -685,8 +1443,6 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
         splits->splits[i].align = 1;
         splits->splits[i].width_min = 0;
         splits->splits[i].width_max = -1;
-        splits->splits[i].mutex = malloc(sizeof(pthread_mutex_t));
-        pthread_mutex_init(splits->splits[i].mutex, NULL);
     }
 
     tint format_len = strlen(format);
@@ -709,7 +1465,7 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 }
                 strncpy(splits->splits[split_count].data, format + last_index, cur_index - last_index);
                 splits->splits[split_count].data[cur_index - last_index] = '\0';
-                splits->splits[split_count].write_buf = write_direct;
+                splits->splits[split_count].type = SPLIT_LITERAL;
                 split_count ++;
             }
 
@@ -733,7 +1489,7 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 }
                 splits->splits[split_count].data[0] = '%';
                 splits->splits[split_count].data[1] = '\0';
-                splits->splits[split_count].write_buf = write_direct;
+                splits->splits[split_count].type = SPLIT_LITERAL;
                 split_count ++;
                 cur_index ++;
                 last_index = cur_index;
@@ -759,6 +1515,11 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 tchar dig_min_buf[3] = "99";
                 tchar dig_max_buf[3] = "99";
                 tint dot_index = t_string_find_char(format + last_index, 0, '.', TRUE);
+                if (dot_index >= cur_index - last_index)
+                {
+                    /* dot belongs to following text */
+                    dot_index = -1;
+                }
                 if (-1 == dot_index)
                 {
                     if (cur_index - last_index <= 2)
@@ -777,10 +1538,11 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                     }
                     t_string_to_int(dig_min_buf, &dig_min);
 
-                    if (cur_index - dot_index <= 3)
+                    tint max_len = cur_index - last_index - dot_index - 1;
+                    if (max_len <= 2)
                     {
-                        strncpy(dig_max_buf, format + last_index + dot_index + 1, cur_index - dot_index - 1);
-                        dig_max_buf[cur_index - dot_index - 1] = '\0';
+                        strncpy(dig_max_buf, format + last_index + dot_index + 1, max_len);
+                        dig_max_buf[max_len] = '\0';
                     }
                     t_string_to_int(dig_max_buf, &dig_max);
                 }
@@ -802,50 +1564,82 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 }
                 strncpy(splits->splits[split_count].data, format + cur_index, len);
                 splits->splits[split_count].data[len] = '\0';
-                splits->splits[split_count].write_buf = write_time;
+                splits->splits[split_count].type = SPLIT_TIME;
+                splits->splits[split_count].id = timestamp_new_id();
                 cur_index = temp_index + 1;
             }
                 break;
+            /* utc iso-8601 time */
+            case 'D':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_TIME_ISO;
+                cur_index ++;
+                break;
             /* millsecond */
             case 'S':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_time_ms;
+                splits->splits[split_count].type = SPLIT_TIME_MS;
                 cur_index ++;
                 break;
             /* microsecond */
             case 'M':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_time_us;
+                splits->splits[split_count].type = SPLIT_TIME_US;
+                cur_index ++;
+                break;
+            /* nanosecond */
+            case 'O':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_TIME_NS;
+                cur_index ++;
+                break;
+            /* seconds since epoch with nanosecond */
+            case 'E':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_TIME_EPOCH;
+                cur_index ++;
+                break;
+            /* monotonic time since tlog_open */
+            case 'r':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_UPTIME;
+                timestamp_enable_uptime();
                 cur_index ++;
                 break;
             /* file name */
             case 'f':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_filename;
+                splits->splits[split_count].type = SPLIT_FILENAME;
                 cur_index ++;
                 break;
             /* __FILE__ */
             case 'F':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_filename_full;
+                splits->splits[split_count].type = SPLIT_FILENAME_FULL;
                 cur_index ++;
                 break;
             /* __LINE__ */
             case 'L':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_line;
+                splits->splits[split_count].type = SPLIT_LINE;
                 cur_index ++;
                 break;
             /* __func__ */
             case 'U':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_function;
+                splits->splits[split_count].type = SPLIT_FUNCTION;
                 cur_index ++;
                 break;
             /* user input message */
             case 'm':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_message;
+                splits->splits[split_count].type = SPLIT_MESSAGE;
+                cur_index ++;
+                break;
+            /* user input message, control characters escaped */
+            case 'q':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_MESSAGE_SAFE;
                 cur_index ++;
                 break;
             /* \n */
@@ -857,37 +1651,73 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 }
                 splits->splits[split_count].data[0] = '\n';
                 splits->splits[split_count].data[1] = '\0';
-                splits->splits[split_count].write_buf = write_direct;
+                splits->splits[split_count].type = SPLIT_LITERAL;
                 cur_index ++;
                 break;
             /* level:debug */
             case 'V':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_level_upper;
+                splits->splits[split_count].type = SPLIT_LEVEL_UPPER;
                 cur_index ++;
                 break;
             /* level:DEBUG */
             case 'v':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_level_lower;
+                splits->splits[split_count].type = SPLIT_LEVEL_LOWER;
                 cur_index ++;
                 break;
             /*hex tid*/
             case 't':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_tid_hex;
+                splits->splits[split_count].type = SPLIT_TID_HEX;
                 cur_index ++;
                 break;
             /* tid */
             case 'T':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_tid;
+                splits->splits[split_count].type = SPLIT_TID;
+                cur_index ++;
+                break;
+            /* kernel tid */
+            case 'k':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_KTID;
+                cur_index ++;
+                break;
+            /* thread name */
+            case 'N':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_THREAD_NAME;
                 cur_index ++;
                 break;
             /* pid */
             case 'p':
                 splits->splits[split_count].data = NULL;
-                splits->splits[split_count].write_buf = write_pid;
+                splits->splits[split_count].type = SPLIT_PID;
+                cur_index ++;
+                break;
+            /* category name, folded when attached to rule */
+            case 'c':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_CATEGORY;
+                cur_index ++;
+                break;
+            /* structured fields, logfmt */
+            case 'K':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_FIELDS_LOGFMT;
+                cur_index ++;
+                break;
+            /* structured fields, json */
+            case 'J':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_FIELDS_JSON;
+                cur_index ++;
+                break;
+            /* whole record, json */
+            case 'j':
+                splits->splits[split_count].data = NULL;
+                splits->splits[split_count].type = SPLIT_JSON_RECORD;
                 cur_index ++;
                 break;
             /* MDC */
@@ -904,7 +1734,7 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                 }
                 strncpy(splits->splits[split_count].data, format + cur_index, len);
                 splits->splits[split_count].data[len] = '\0';
-                splits->splits[split_count].write_buf = write_mdc;
+                splits->splits[split_count].type = SPLIT_MDC;
                 cur_index = temp_index + 1;
             }
                 break;
@@ -933,12 +1763,17 @@ static split_format *format_to_split_quick(const tchar *format, tuint32 count)
                     goto ERROR;
                 }
                 strcpy(splits->splits[split_count].data, format + last_index);
-                splits->splits[split_count].write_buf = write_direct;
+                splits->splits[split_count].type = SPLIT_LITERAL;
             }
             break;
         }
     }
 
+    if (0 != split_format_fuse(splits))
+    {
+        goto ERROR;
+    }
+
     return splits;
 
 ERROR:
@@ -1173,6 +2008,8 @@ tbool format_validation(const tchar *format, tuint32 *count)
             case 'U':
             /* user input message */
             case 'm':
+            /* user input message, control characters escaped */
+            case 'q':
             /* \n */
             case 'n':
             /* level:debug */
@@ -1183,12 +2020,32 @@ tbool format_validation(const tchar *format, tuint32 *count)
             case 'S':
             /* us */
             case 'M':
+            /* ns */
+            case 'O':
+            /* seconds since epoch */
+            case 'E':
+            /* uptime */
+            case 'r':
+            /* utc iso-8601 time */
+            case 'D':
             /* hex tid */
             case 't':
             /* tid */
             case 'T':
+            /* kernel tid */
+            case 'k':
+            /* thread name */
+            case 'N':
             /* pid */
             case 'p':
+            /* category name */
+            case 'c':
+            /* structured fields, logfmt */
+            case 'K':
+            /* structured fields, json */
+            case 'J':
+            /* whole record, json */
+            case 'j':
                 split_count ++;
                 cur_index ++;
                 break;
@@ -1266,25 +2123,218 @@ split_format *format_to_split(const tchar *format)
 }
 
 /**
- * @brief convert split format to string
+ * @brief copy split format and fold process constant splits into literals,
+ *        category name is always folded, pid is folded if identity given
+ * @param splits - split format handle
+ * @param category - category name
+ * @param ident - identity of process, NULL means pid is not folded
+ * @return folded split format, NULL means no memory
+ */
+split_format *format_split_fold(const split_format *splits, const tchar *category,
+        const thread_identity *ident)
+{
+    T_ASSERT(NULL != splits);
+    T_ASSERT(NULL != category);
+
+    split_format *folded = malloc(sizeof(split_format));
+    if (NULL == folded)
+    {
+        return NULL;
+    }
+    folded->count = 0;
+    folded->splits = calloc(sizeof(split_format_single), (splits->count > 0) ? splits->count : 1);
+    if (NULL == folded->splits)
+    {
+        free(folded);
+        return NULL;
+    }
+
+    tbuffer text;
+    t_buffer_init(&text);
+    for (tuint32 i = 0; i < splits->count; ++i)
+    {
+        const split_format_single *split = &splits->splits[i];
+        split_format_single *dst = &folded->splits[folded->count];
+        *dst = *split;
+        dst->data = NULL;
+        folded->count++;
+
+        /* constant text with width applied becomes plain literal */
+        t_buffer_clear(&text);
+        if (SPLIT_LITERAL == split->type)
+        {
+            align_write(&text, split, split->data, split->len);
+        }
+        else if (SPLIT_CATEGORY == split->type)
+        {
+            align_write(&text, split, category, strlen(category));
+        }
+        else if ((SPLIT_PID == split->type) && (NULL != ident))
+        {
+            align_write(&text, split, ident->pid_str, ident->pid_len);
+        }
+        else
+        {
+            if (NULL != split->data)
+            {
+                tuint32 len = strlen(split->data);
+                dst->data = malloc(len + 1);
+                if (NULL == dst->data)
+                {
+                    goto ERROR;
+                }
+                memcpy(dst->data, split->data, len + 1);
+            }
+            continue;
+        }
+
+        dst->type = SPLIT_LITERAL;
+        dst->align = 1;
+        dst->width_min = 0;
+        dst->width_max = -1;
+        dst->len = text.len;
+        dst->data = malloc(text.len + 1);
+        if (NULL == dst->data)
+        {
+            goto ERROR;
+        }
+        memcpy(dst->data, (0 != text.len) ? text.data : "", text.len);
+        dst->data[text.len] = '\0';
+    }
+    t_buffer_free(&text);
+
+    if (0 != split_format_fuse(folded))
+    {
+        split_format_free(folded);
+        return NULL;
+    }
+
+    return folded;
+
+ERROR:
+    t_buffer_free(&text);
+    split_format_free(folded);
+    return NULL;
+}
+
+/**
+ * @brief convert split format to string, append to buffer
  * @param buf - string output buffer
  * @param split - split format handle
  * @param pre - preprocess information
  * @return success written length
  */
-tuint32 format_split_to_string(tchar *buf, const split_format *splits, const preprocess_info *pre)
+tuint32 format_split_to_string(tbuffer *buf, const split_format *splits, const preprocess_info *pre)
 {
     T_ASSERT(NULL != splits);
     T_ASSERT(NULL != buf);
-    tuint32 written_len = 0;
-    tchar *start = buf;
-    for (tuint32 i = 0; i < splits->count; ++i)
+    tuint32 start = buf->len;
+    const split_format_single *split = splits->splits;
+    const split_format_single *end = split + splits->count;
+    for (; split < end; ++split)
     {
-        written_len = splits->splits[i].write_buf(buf, &splits->splits[i], pre);
-        buf += written_len;
+        switch (split->type)
+        {
+        case SPLIT_LITERAL:
+            write_direct(buf, split, pre);
+            break;
+        case SPLIT_TIME:
+            write_time(buf, split, pre);
+            break;
+        case SPLIT_TIME_ISO:
+            write_time_iso(buf, split, pre);
+            break;
+        case SPLIT_TIME_MS:
+            write_time_ms(buf, split, pre);
+            break;
+        case SPLIT_TIME_US:
+            write_time_us(buf, split, pre);
+            break;
+        case SPLIT_TIME_NS:
+            write_time_ns(buf, split, pre);
+            break;
+        case SPLIT_TIME_EPOCH:
+            write_time_epoch(buf, split, pre);
+            break;
+        case SPLIT_UPTIME:
+            write_uptime(buf, split, pre);
+            break;
+        case SPLIT_FILENAME:
+            write_filename(buf, split, pre);
+            break;
+        case SPLIT_FILENAME_FULL:
+            write_filename_full(buf, split, pre);
+            break;
+        case SPLIT_LINE:
+            write_line(buf, split, pre);
+            break;
+        case SPLIT_FUNCTION:
+            write_function(buf, split, pre);
+            break;
+        case SPLIT_MESSAGE:
+            write_message(buf, split, pre);
+            break;
+        case SPLIT_MESSAGE_SAFE:
+            write_message_safe(buf, split, pre);
+            break;
+        case SPLIT_LEVEL_UPPER:
+            write_level_upper(buf, split, pre);
+            break;
+        case SPLIT_LEVEL_LOWER:
+            write_level_lower(buf, split, pre);
+            break;
+        case SPLIT_TID_HEX:
+            write_tid_hex(buf, split, pre);
+            break;
+        case SPLIT_TID:
+            write_tid(buf, split, pre);
+            break;
+        case SPLIT_KTID:
+            write_ktid(buf, split, pre);
+            break;
+        case SPLIT_THREAD_NAME:
+            write_thread_name(buf, split, pre);
+            break;
+        case SPLIT_PID:
+            write_pid(buf, split, pre);
+            break;
+        case SPLIT_FIELDS_LOGFMT:
+            write_fields_logfmt(buf, split, pre);
+            break;
+        case SPLIT_FIELDS_JSON:
+            write_fields_json(buf, split, pre);
+            break;
+        case SPLIT_MDC:
+            write_mdc(buf, split, pre);
+            break;
+        case SPLIT_JSON_RECORD:
+            write_json_record(buf, split, pre);
+            break;
+        default:
+            break;
+        }
     }
 
-    return buf - start;
+    return buf->len - start;
 }
 
+/**
+ * @brief check if split format contains mdc
+ * @param splits - split format handle
+ * @return TRUE: contains mdc
+ */
+tbool format_split_has_mdc(const split_format *splits)
+{
+    T_ASSERT(NULL != splits);
+    for (tuint32 i = 0; i < splits->count; ++i)
+    {
+        if ((SPLIT_MDC == splits->splits[i].type) ||
+            (SPLIT_JSON_RECORD == splits->splits[i].type))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
 
@@ -8,10 +8,17 @@
 #ifndef _FORMAT_H_
 #define _FORMAT_H_
 
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include "ttypes.h"
 #include "tkeyfile.h"
 #include "thash_string.h"
 #include "mdc.h"
+#include "tbuffer.h"
+#include "identity.h"
+#include "../include/tlog/tlog.h"
 
 T_BEGIN_DECLS
 
@@ -20,13 +27,28 @@ typedef struct _split_format split_format;
 /* preprocess information */
 typedef struct
 {
-    const tchar *file;
-    const tchar *func;
-    tlong line;
-    const tchar *line_str;
-    tuint32 level;
+    const tlog_callsite *site;
+    /* 
+     * rendered user message, if NULL, message is rendered in place
+     * from fmt with args or packed arguments
+     */
     const tchar *user_msg;
+    const tchar *fmt;
+    va_list *args;
+    const tchar *packed;
+    tuint32 packed_len;
+    /* structured fields */
+    const tlog_field *fields;
+    tuint32 field_count;
+    /* scratch buffer for user message with width constraints */
+    tbuffer *msg_buf;
     const mdc *mdc_handle;
+    /* log generate time, read once per record */
+    struct timespec ts;
+    /* monotonic time since tlog_open, only read when some format needs it */
+    struct timespec uptime;
+    /* thread identity, NULL means current thread */
+    const thread_identity *ident;
 }preprocess_info;
 
 T_EXTERN thash_string *format_new(void);
@@ -37,7 +59,11 @@ T_EXTERN const tchar *get_format(const thash_string *hash, const tchar *name);
 T_EXTERN const split_format *get_format_split(const thash_string *hash, const tchar *name);
 T_EXTERN tbool format_validation(const tchar *format, tuint32 *count);
 T_EXTERN split_format *format_to_split(const tchar *format);
-T_EXTERN tuint32 format_split_to_string(tchar *buf, const split_format *splits, const preprocess_info *pre);
+T_EXTERN void split_format_free(split_format *split);
+T_EXTERN split_format *format_split_fold(const split_format *splits, const tchar *category,
+        const thread_identity *ident);
+T_EXTERN tuint32 format_split_to_string(tbuffer *buf, const split_format *splits, const preprocess_info *pre);
+T_EXTERN tbool format_split_has_mdc(const split_format *splits);
 T_EXTERN tint format_put_mdc(const tchar *key, const tchar *value);
 T_EXTERN tchar *format_get_mdc(const tchar *key);
 T_EXTERN void format_remove_mdc(const tchar *key);
@@ -21,5 +21,15 @@
 #define DEFAULT_FORMAT_NAME      "default"
 #define DEFAULT_FORMAT           "%d(%F %T) %-6V [%F:%L:%U] %m%n"
 
+/* general group keys */
+#define GENERAL_KEY_ASYNC            "async"
+#define GENERAL_KEY_ASYNC_BUFFER     "async_buffer_size"
+#define GENERAL_KEY_DEFERRED_FORMAT  "deferred_format"
+#define GENERAL_KEY_COARSE_CLOCK     "coarse_clock"
+#define GENERAL_KEY_SYNC_INTERVAL    "sync_interval"
+#define GENERAL_KEY_SYNC_BYTES       "sync_bytes"
+
+#define DEFAULT_ASYNC_BUFFER_SIZE    (1024 * 1024)
+
 
 #endif /* _GLOBAL_H_ */
@@ -0,0 +1,148 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+/* pthread_getname_np */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "tassert.h"
+#include "tstring.h"
+#include "identity.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+/* per thread identity cache */
+typedef struct
+{
+    tbool valid;
+    thread_identity ident;
+}identity_cache;
+
+/****************************************************
+ * static variable
+ ****************************************************/
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief invalidate identity of forking thread in child process, pid
+ *        and kernel thread id are changed after fork
+ */
+static void identity_atfork_child(void)
+{
+    identity_cache *cache = pthread_getspecific(cache_key);
+    if (NULL != cache)
+    {
+        cache->valid = FALSE;
+    }
+}
+
+/**
+ * @brief create identity cache key
+ */
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, free);
+    pthread_atfork(NULL, NULL, identity_atfork_child);
+}
+
+/**
+ * @brief get kernel thread id of current thread
+ * @return kernel thread id, 0 means not supported
+ */
+static pid_t get_ktid(void)
+{
+#ifdef SYS_gettid
+    return (pid_t)syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief initialize identity and render all fields
+ * @param ident - identity to initialize
+ * @param tid - thread id
+ * @param ktid - kernel thread id, 0 means unknown
+ * @param pid - process id
+ * @param name - thread name, NULL means unknown
+ */
+void identity_init(thread_identity *ident, pthread_t tid, pid_t ktid,
+        pid_t pid, const tchar *name)
+{
+    T_ASSERT(NULL != ident);
+
+    ident->tid = tid;
+    ident->ktid = ktid;
+    ident->pid = pid;
+    ident->tid_len = t_string_from_uint(ident->tid_str, (tulong)tid);
+    ident->tid_hex_str[0] = '0';
+    ident->tid_hex_str[1] = 'x';
+    ident->tid_hex_len = t_string_from_hex(ident->tid_hex_str + 2, (tulong)tid) + 2;
+    ident->ktid_len = t_string_from_uint(ident->ktid_str, (tuint32)ktid);
+    ident->pid_len = t_string_from_uint(ident->pid_str, (tuint32)pid);
+
+    ident->name_len = 0;
+    if (NULL != name)
+    {
+        while ((ident->name_len < IDENTITY_NAME_LEN - 1) &&
+               ('\0' != name[ident->name_len]))
+        {
+            ident->name[ident->name_len] = name[ident->name_len];
+            ident->name_len ++;
+        }
+    }
+    ident->name[ident->name_len] = '\0';
+}
+
+/**
+ * @brief get identity of current thread, rendered on first use and
+ *        after fork, thread name is read on first use only
+ * @return identity of current thread, NULL means no memory
+ */
+const thread_identity *identity_current(void)
+{
+    pthread_once(&cache_once, cache_key_create);
+    identity_cache *cache = pthread_getspecific(cache_key);
+    if (NULL == cache)
+    {
+        cache = calloc(1, sizeof(identity_cache));
+        if (NULL == cache)
+        {
+            return NULL;
+        }
+        if (0 != pthread_setspecific(cache_key, cache))
+        {
+            free(cache);
+            return NULL;
+        }
+    }
+
+    if (!cache->valid)
+    {
+        tchar name[IDENTITY_NAME_LEN] = {0};
+        pthread_t tid = pthread_self();
+        if (0 != pthread_getname_np(tid, name, IDENTITY_NAME_LEN))
+        {
+            name[0] = '\0';
+        }
+        identity_init(&cache->ident, tid, get_ktid(), getpid(), name);
+        cache->valid = TRUE;
+    }
+
+    return &cache->ident;
+}
@@ -0,0 +1,45 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _IDENTITY_H_
+#define _IDENTITY_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+/* max thread name length, include '\0' */
+#define IDENTITY_NAME_LEN    16
+
+/* thread identity, all fields are rendered once */
+typedef struct
+{
+    pthread_t tid;
+    /* kernel thread id, 0 means unknown */
+    pid_t ktid;
+    pid_t pid;
+    tuint8 tid_len;
+    tuint8 tid_hex_len;
+    tuint8 ktid_len;
+    tuint8 pid_len;
+    tuint8 name_len;
+    tchar tid_str[24];
+    tchar tid_hex_str[24];
+    tchar ktid_str[12];
+    tchar pid_str[12];
+    tchar name[IDENTITY_NAME_LEN];
+}thread_identity;
+
+T_EXTERN const thread_identity *identity_current(void);
+T_EXTERN void identity_init(thread_identity *ident, pthread_t tid, pid_t ktid,
+        pid_t pid, const tchar *name);
+
+T_END_DECLS
+
+#endif /* _IDENTITY_H_ */
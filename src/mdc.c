@@ -37,6 +37,13 @@ typedef struct
     tlist node;
 }mdc_list_node;
 
+/* mdc iterator context */
+typedef struct
+{
+    mdc_func func;
+    void *userdata;
+}mdc_foreach_context;
+
 
 /****************************************************
  * static variable 
@@ -264,6 +271,47 @@ void mdc_remove(mdc *pmdc, const tchar *key)
     }
 }
 
+/**
+ * @brief call mdc iterator with key-value of hash node
+ * @param data - mdc hash node
+ * @param userdata - iterator context
+ * @return 0
+ */
+static tint mdc_foreach_node(void *data, void *userdata)
+{
+    thash_string_node *string_node = (thash_string_node *)data;
+    mdc_hash_node *hash_node = t_hash_string_entry(string_node, mdc_hash_node, node);
+    mdc_foreach_context *ctx = (mdc_foreach_context *)userdata;
+    ctx->func(hash_node->node.key, hash_node->value, ctx->userdata);
+    return 0;
+}
+
+/**
+ * @brief iterate all mdc key-value of current thread
+ * @param pmdc - mdc handle
+ * @param func - iterator callback
+ * @param userdata - userdata passed to callback
+ */
+void mdc_foreach(const mdc *pmdc, mdc_func func, void *userdata)
+{
+    T_ASSERT(NULL != pmdc);
+    T_ASSERT(NULL != func);
+
+    pthread_t tid = pthread_self();
+    tlist *tmp_node;
+    mdc_list_node *list_node;
+    t_list_foreach(tmp_node, pmdc)
+    {
+        list_node = t_list_entry(tmp_node, mdc_list_node, node);
+        /* find list node */
+        if (pthread_equal(list_node->tid, tid))
+        {
+            mdc_foreach_context ctx = {func, userdata};
+            t_hash_string_foreach(list_node->mdc_hash, mdc_foreach_node, &ctx);
+            break;
+        }
+    }
+}
 
 /**
  * @brief free mdc hash table
@@ -15,6 +15,9 @@ T_BEGIN_DECLS
 
 typedef tlist mdc;
 
+/* mdc iterator callback */
+typedef void (*mdc_func)(const tchar *key, const tchar *value, void *userdata);
+
 /* mdc interface */
 T_EXTERN mdc* mdc_new(void);
 T_EXTERN void mdc_free(mdc *pmdc);
@@ -22,6 +25,7 @@ T_EXTERN void mdc_clean(mdc *pmdc);
 T_EXTERN tint mdc_put(mdc *pmdc, const tchar *key, const tchar *value);
 T_EXTERN tchar *mdc_get(const mdc *pmdc, const tchar *key);
 T_EXTERN void mdc_remove(mdc *pmdc, const tchar *key);
+T_EXTERN void mdc_foreach(const mdc *pmdc, mdc_func func, void *userdata);
 
 T_END_DECLS
 
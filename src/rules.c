@@ -65,25 +65,50 @@ static void split_category_and_level(const tchar *rules, tchar *name, tchar *lev
 }
 
 /**
- * @brief split rules string to format and output
+ * @brief split rules string to format, output and options
  * @param rules - rules string to split
  * @param format - format string output
  * @param output - ouput string output
+ * @param options - options string output
  */
-static void split_format_and_output(const tchar *rules, tchar *format, tchar *output)
+static void split_format_and_output(const tchar *rules, tchar *format, tchar *output,
+        tchar *options)
 {
     T_ASSERT(NULL != rules);
     T_ASSERT(NULL != format);
     T_ASSERT(NULL != output);
+    T_ASSERT(NULL != options);
 
     tint index = t_string_find_char(rules, 0, ';', TRUE);
     tchar buf[256];
+    options[0] = '\0';
     if (-1 != index)
     {
         t_string_left(rules, index, buf);
         t_string_trimmed(buf, format);
-        t_string_right(rules, strlen(rules) - index - 1, buf);
-        t_string_trimmed(buf, output);
+        /* pipe command may contain ';', so pipe output takes no options */
+        tint out_index = index + 1;
+        while (' ' == rules[out_index])
+        {
+            out_index++;
+        }
+        tint opt_index = -1;
+        if ('|' != rules[out_index])
+        {
+            opt_index = t_string_find_char(rules, out_index, ';', TRUE);
+        }
+        if (-1 != opt_index)
+        {
+            t_string_mid(rules, index + 1, opt_index - index - 1, buf);
+            t_string_trimmed(buf, output);
+            t_string_right(rules, strlen(rules) - opt_index - 1, buf);
+            t_string_trimmed(buf, options);
+        }
+        else
+        {
+            t_string_right(rules, strlen(rules) - index - 1, buf);
+            t_string_trimmed(buf, output);
+        }
     }
     else
     {
@@ -106,16 +131,19 @@ static tint rules_process(void *key, void *value, void *userdata)
     tchar level[256];
     tchar format[256];
     tchar output[256];
+    tchar options[256];
     rule_userdata *data = (rule_userdata *)userdata;
     split_category_and_level((const tchar *)key, category, level);
-    split_format_and_output((const tchar *)value, format, output);
-    return add_category(data->cat_hash, data->format_hash, category, level, format, output);
+    split_format_and_output((const tchar *)value, format, output, options);
+    return add_category(data->cat_hash, data->format_hash, category, level, format,
+            output, options);
 }
 
 
 /**
  * @brief filter rules in configure file
- *        rule example: category_name.level=output;format
+ *        rule example: category_name.level=format;output;options,
+ *        pipe output takes the rest of the rule and has no options
  * @param keyfile - configure file handle
  * @return 0 means no error
  */
@@ -136,7 +164,7 @@ tint filter_rules(const tkeyfile *keyfile, const thash_string *format_hash, thas
     if (0 == t_keyfile_key_count(keyfile, GROUP_NAME_RULES))
     {
         err = add_category(*cat_hash, format_hash, DEFAULT_CATEGORY_NAME, DEFAULT_LEVEL,
-                DEFAULT_FORMAT_NAME, DEFAULT_OUTPUT);
+                DEFAULT_FORMAT_NAME, DEFAULT_OUTPUT, "");
     }
     else
     {
@@ -0,0 +1,193 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "tbuffer.h"
+#include "tassert.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+#define BUFFER_MIN_SIZE 256
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+
+/****************************************************
+ * static variable 
+ ****************************************************/
+
+/****************************************************
+ * functions 
+ ****************************************************/
+/**
+ * @brief init buffer, no memory allocated until first write
+ * @param buf - buffer handle
+ */
+void t_buffer_init(tbuffer *buf)
+{
+    T_ASSERT(NULL != buf);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->size = 0;
+}
+
+/**
+ * @brief free buffer memory
+ * @param buf - buffer handle
+ */
+void t_buffer_free(tbuffer *buf)
+{
+    T_ASSERT(NULL != buf);
+    free(buf->data);
+    t_buffer_init(buf);
+}
+
+/**
+ * @brief clear buffer content, memory is kept for reuse
+ * @param buf - buffer handle
+ */
+void t_buffer_clear(tbuffer *buf)
+{
+    T_ASSERT(NULL != buf);
+    buf->len = 0;
+    if (NULL != buf->data)
+    {
+        buf->data[0] = '\0';
+    }
+}
+
+/**
+ * @brief make sure buffer has space for len more bytes and '\0'
+ * @param buf - buffer handle
+ * @param len - bytes to append
+ * @return error code, 0 means no error
+ */
+tint t_buffer_reserve(tbuffer *buf, tuint32 len)
+{
+    T_ASSERT(NULL != buf);
+
+    if (len >= buf->size - buf->len)
+    {
+        if (len > 0xffffffffu - buf->len - 1)
+        {
+            return -ENOMEM;
+        }
+
+        tuint32 need = buf->len + len + 1;
+        tuint32 size = (buf->size > 0) ? buf->size : BUFFER_MIN_SIZE;
+        while (size < need)
+        {
+            size = (size > 0x7fffffffu) ? need : (size << 1);
+        }
+
+        tchar *data = realloc(buf->data, size);
+        if (NULL == data)
+        {
+            return -ENOMEM;
+        }
+        buf->data = data;
+        buf->size = size;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief append data to buffer
+ * @param buf - buffer handle
+ * @param data - data to append
+ * @param len - data length
+ * @return error code, 0 means no error
+ */
+tint t_buffer_append(tbuffer *buf, const tchar *data, tuint32 len)
+{
+    T_ASSERT(NULL != buf);
+    T_ASSERT((NULL != data) || (0 == len));
+
+    if (0 != t_buffer_reserve(buf, len))
+    {
+        return -ENOMEM;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+
+    return 0;
+}
+
+/**
+ * @brief append repeated character to buffer
+ * @param buf - buffer handle
+ * @param c - character
+ * @param count - repeat count
+ * @return error code, 0 means no error
+ */
+tint t_buffer_append_char(tbuffer *buf, tchar c, tuint32 count)
+{
+    T_ASSERT(NULL != buf);
+
+    if (0 != t_buffer_reserve(buf, count))
+    {
+        return -ENOMEM;
+    }
+
+    memset(buf->data + buf->len, c, count);
+    buf->len += count;
+    buf->data[buf->len] = '\0';
+
+    return 0;
+}
+
+/**
+ * @brief append formatted string to buffer, never truncates
+ * @param buf - buffer handle
+ * @param fmt - printf format
+ * @param args - format arguments, not changed
+ * @return error code, 0 means no error
+ */
+tint t_buffer_vprintf(tbuffer *buf, const tchar *fmt, va_list args)
+{
+    T_ASSERT(NULL != buf);
+    T_ASSERT(NULL != fmt);
+
+    if (0 != t_buffer_reserve(buf, 0))
+    {
+        return -ENOMEM;
+    }
+
+    /* try free space first, grow to exact size if not enough */
+    va_list args_copy;
+    va_copy(args_copy, args);
+    tint len = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, args_copy);
+    va_end(args_copy);
+    if (len < 0)
+    {
+        buf->data[buf->len] = '\0';
+        return -EINVAL;
+    }
+
+    if ((tuint32)len >= buf->size - buf->len)
+    {
+        if (0 != t_buffer_reserve(buf, len))
+        {
+            buf->data[buf->len] = '\0';
+            return -ENOMEM;
+        }
+        va_copy(args_copy, args);
+        vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, args_copy);
+        va_end(args_copy);
+    }
+    buf->len += len;
+
+    return 0;
+}
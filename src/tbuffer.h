@@ -0,0 +1,34 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _TBUFFER_H_
+#define _TBUFFER_H_
+
+#include <stdarg.h>
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+/* growable buffer, data is always '\0' terminated when not empty */
+typedef struct
+{
+    tchar *data;
+    tuint32 len;
+    tuint32 size;
+}tbuffer;
+
+T_EXTERN void t_buffer_init(tbuffer *buf);
+T_EXTERN void t_buffer_free(tbuffer *buf);
+T_EXTERN void t_buffer_clear(tbuffer *buf);
+T_EXTERN tint t_buffer_reserve(tbuffer *buf, tuint32 len);
+T_EXTERN tint t_buffer_append(tbuffer *buf, const tchar *data, tuint32 len);
+T_EXTERN tint t_buffer_append_char(tbuffer *buf, tchar c, tuint32 count);
+T_EXTERN tint t_buffer_vprintf(tbuffer *buf, const tchar *fmt, va_list args);
+
+T_END_DECLS
+
+#endif /* _TBUFFER_H_ */
@@ -0,0 +1,374 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "tassert.h"
+#include "timestamp.h"
+
+/****************************************************
+ * macros definition
+ ****************************************************/
+/* rendered timestamp cache size of each thread, must be power of 2 */
+#define TIMESTAMP_CACHE_SIZE    8
+
+/*
+ * utc offset only changes on 15 minutes boundaries in real time zones,
+ * so it is looked up once in every window
+ */
+#define TZ_WINDOW               900
+
+#define SECONDS_PER_DAY         86400
+
+/****************************************************
+ * struct definition
+ ****************************************************/
+/* rendered timestamp of one format */
+typedef struct
+{
+    /* format id, 0 means empty */
+    tuint32 id;
+    time_t sec;
+    tuint32 len;
+    tchar text[TIMESTAMP_MAX_LEN + 1];
+}timestamp_entry;
+
+/* per thread timestamp cache */
+typedef struct
+{
+    /* utc offset of current window */
+    tbool tz_valid;
+    time_t tz_start;
+    long gmtoff;
+    tint isdst;
+    const tchar *zone;
+    /* broken down local time of last second */
+    tbool tm_valid;
+    time_t tm_sec;
+    struct tm tm;
+    timestamp_entry entries[TIMESTAMP_CACHE_SIZE];
+}timestamp_cache;
+
+/****************************************************
+ * static variable
+ ****************************************************/
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static tuint32 id_seed = 0;
+/* log clock */
+static clockid_t log_clock = CLOCK_REALTIME;
+/* monotonic start time, uptime is measured from it */
+static tint64 start_ns = 0;
+/* some format needs uptime */
+static tbool uptime_enabled = FALSE;
+
+/* days before month */
+static const tint month_days[2][12] =
+{
+    {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334},
+    {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335}
+};
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief create timestamp cache key
+ */
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, free);
+}
+
+/**
+ * @brief get timestamp cache of current thread
+ * @return timestamp cache, NULL means no memory
+ */
+static timestamp_cache *get_cache(void)
+{
+    pthread_once(&cache_once, cache_key_create);
+    timestamp_cache *cache = pthread_getspecific(cache_key);
+    if (NULL == cache)
+    {
+        cache = calloc(1, sizeof(timestamp_cache));
+        if (NULL == cache)
+        {
+            return NULL;
+        }
+        if (0 != pthread_setspecific(cache_key, cache))
+        {
+            free(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+/**
+ * @brief select log clock
+ * @param coarse - TRUE: coarse clock, cheaper but only has tick
+ *        resolution, FALSE: precise clock
+ */
+void timestamp_set_coarse(tbool coarse)
+{
+#ifdef CLOCK_REALTIME_COARSE
+    clockid_t clock = coarse ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME;
+#else
+    clockid_t clock = CLOCK_REALTIME;
+    (void)coarse;
+#endif
+    __atomic_store_n(&log_clock, clock, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief get monotonic time in nanosecond
+ * @return monotonic time
+ */
+static inline tint64 monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (tint64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief mark uptime start, called when tlog opened
+ */
+void timestamp_start(void)
+{
+    __atomic_store_n(&start_ns, monotonic_ns(), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief enable uptime reading, called when format needs uptime
+ */
+void timestamp_enable_uptime(void)
+{
+    __atomic_store_n(&uptime_enabled, TRUE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief read log clock, called once for every record, monotonic clock
+ *        is only read when some format needs uptime
+ * @param ts - current time output
+ * @param uptime - monotonic time since start output, zero if not enabled
+ */
+void timestamp_now(struct timespec *ts, struct timespec *uptime)
+{
+    T_ASSERT(NULL != ts);
+    T_ASSERT(NULL != uptime);
+    clock_gettime(__atomic_load_n(&log_clock, __ATOMIC_RELAXED), ts);
+
+    if (__atomic_load_n(&uptime_enabled, __ATOMIC_RELAXED))
+    {
+        tint64 ns = monotonic_ns() - __atomic_load_n(&start_ns, __ATOMIC_RELAXED);
+        if (ns < 0)
+        {
+            ns = 0;
+        }
+        uptime->tv_sec = ns / 1000000000LL;
+        uptime->tv_nsec = ns % 1000000000LL;
+    }
+    else
+    {
+        uptime->tv_sec = 0;
+        uptime->tv_nsec = 0;
+    }
+}
+
+/**
+ * @brief allocate unique id for timestamp format
+ * @return format id, never 0
+ */
+tuint32 timestamp_new_id(void)
+{
+    tuint32 id = __atomic_add_fetch(&id_seed, 1, __ATOMIC_RELAXED);
+    if (0 == id)
+    {
+        id = __atomic_add_fetch(&id_seed, 1, __ATOMIC_RELAXED);
+    }
+
+    return id;
+}
+
+/**
+ * @brief convert seconds since epoch to broken down utc time,
+ *        no time zone is involved
+ * @param sec - seconds since epoch
+ * @param tm - broken down time output
+ */
+void timestamp_utc(time_t sec, struct tm *tm)
+{
+    T_ASSERT(NULL != tm);
+
+    tint64 days = sec / SECONDS_PER_DAY;
+    tint64 rem = sec % SECONDS_PER_DAY;
+    if (rem < 0)
+    {
+        rem += SECONDS_PER_DAY;
+        days--;
+    }
+
+    tm->tm_hour = rem / 3600;
+    tm->tm_min = rem / 60 % 60;
+    tm->tm_sec = rem % 60;
+    /* 1970-01-01 is thursday */
+    tm->tm_wday = (tint)((days % 7 + 11) % 7);
+
+    /* days to civil date, era is 400 years */
+    days += 719468;
+    tint64 era = ((days >= 0) ? days : days - 146096) / 146097;
+    tuint32 doe = (tuint32)(days - era * 146097);
+    tuint32 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    tuint32 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    tuint32 mp = (5 * doy + 2) / 153;
+    tuint32 mday = doy - (153 * mp + 2) / 5 + 1;
+    tuint32 mon = (mp < 10) ? mp + 2 : mp - 10;
+    tint64 year = (tint64)yoe + era * 400 + ((mon < 2) ? 1 : 0);
+
+    tint leap = ((0 == year % 4) && ((0 != year % 100) || (0 == year % 400))) ? 1 : 0;
+    tm->tm_year = (tint)(year - 1900);
+    tm->tm_mon = (tint)mon;
+    tm->tm_mday = (tint)mday;
+    tm->tm_yday = month_days[leap][mon] + mday - 1;
+    tm->tm_isdst = 0;
+    tm->tm_gmtoff = 0;
+    tm->tm_zone = "UTC";
+}
+
+/**
+ * @brief convert seconds since epoch to broken down local time, the
+ *        time zone database is only consulted once in every window
+ * @param sec - seconds since epoch
+ * @param tm - broken down time output
+ * @return TRUE: success
+ */
+tbool timestamp_localtime(time_t sec, struct tm *tm)
+{
+    T_ASSERT(NULL != tm);
+
+    timestamp_cache *cache = get_cache();
+    if (NULL == cache)
+    {
+        return (NULL != localtime_r(&sec, tm));
+    }
+
+    if (cache->tm_valid && (cache->tm_sec == sec))
+    {
+        *tm = cache->tm;
+        return TRUE;
+    }
+
+    time_t start = sec - ((sec % TZ_WINDOW + TZ_WINDOW) % TZ_WINDOW);
+    if (cache->tz_valid && (cache->tz_start == start))
+    {
+        timestamp_utc(sec + cache->gmtoff, tm);
+        tm->tm_isdst = cache->isdst;
+        tm->tm_gmtoff = cache->gmtoff;
+        tm->tm_zone = cache->zone;
+    }
+    else
+    {
+        if (NULL == localtime_r(&sec, tm))
+        {
+            return FALSE;
+        }
+        cache->tz_valid = TRUE;
+        cache->tz_start = start;
+        cache->gmtoff = tm->tm_gmtoff;
+        cache->isdst = tm->tm_isdst;
+        cache->zone = tm->tm_zone;
+    }
+
+    cache->tm_valid = TRUE;
+    cache->tm_sec = sec;
+    cache->tm = *tm;
+
+    return TRUE;
+}
+
+/**
+ * @brief render local time with strftime format, result is cached in
+ *        current thread until second changed
+ * @param id - format id, allocated by timestamp_new_id
+ * @param format - strftime format
+ * @param sec - seconds since epoch
+ * @param len - rendered length output
+ * @return rendered string, valid until next call in same thread,
+ *         NULL means error happened
+ */
+const tchar *timestamp_render(tuint32 id, const tchar *format, time_t sec,
+        tuint32 *len)
+{
+    T_ASSERT(0 != id);
+    T_ASSERT(NULL != format);
+    T_ASSERT(NULL != len);
+
+    timestamp_cache *cache = get_cache();
+    if (NULL == cache)
+    {
+        return NULL;
+    }
+
+    timestamp_entry *entry = &cache->entries[id & (TIMESTAMP_CACHE_SIZE - 1)];
+    if ((entry->id != id) || (entry->sec != sec))
+    {
+        struct tm tm;
+        if (!timestamp_localtime(sec, &tm))
+        {
+            return NULL;
+        }
+        entry->len = strftime(entry->text, TIMESTAMP_MAX_LEN, format, &tm);
+        entry->text[entry->len] = '\0';
+        entry->id = id;
+        entry->sec = sec;
+    }
+
+    *len = entry->len;
+    return entry->text;
+}
+
+/**
+ * @brief write two digits
+ * @param buf - output buffer
+ * @param value - value, 0 - 99
+ */
+static inline void put_digits2(tchar *buf, tuint32 value)
+{
+    buf[0] = '0' + value / 10;
+    buf[1] = '0' + value % 10;
+}
+
+/**
+ * @brief render utc time in iso-8601 format, e.g. 2017-01-02T03:04:05,
+ *        no time zone is involved
+ * @param sec - seconds since epoch
+ * @param buf - output buffer, at least TIMESTAMP_ISO_LEN + 1 bytes
+ */
+void timestamp_iso_utc(time_t sec, tchar *buf)
+{
+    T_ASSERT(NULL != buf);
+
+    struct tm tm;
+    timestamp_utc(sec, &tm);
+    tuint32 year = (tuint32)(tm.tm_year + 1900) % 10000;
+    put_digits2(buf, year / 100);
+    put_digits2(buf + 2, year % 100);
+    buf[4] = '-';
+    put_digits2(buf + 5, tm.tm_mon + 1);
+    buf[7] = '-';
+    put_digits2(buf + 8, tm.tm_mday);
+    buf[10] = 'T';
+    put_digits2(buf + 11, tm.tm_hour);
+    buf[13] = ':';
+    put_digits2(buf + 14, tm.tm_min);
+    buf[16] = ':';
+    put_digits2(buf + 17, tm.tm_sec);
+    buf[TIMESTAMP_ISO_LEN] = '\0';
+}
@@ -0,0 +1,35 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#ifndef _TIMESTAMP_H_
+#define _TIMESTAMP_H_
+
+#include <time.h>
+#include "ttypes.h"
+
+T_BEGIN_DECLS
+
+/* max rendered timestamp length, not include '\0' */
+#define TIMESTAMP_MAX_LEN    99
+
+/* utc iso-8601 length, e.g. 2017-01-02T03:04:05 */
+#define TIMESTAMP_ISO_LEN    19
+
+T_EXTERN void timestamp_set_coarse(tbool coarse);
+T_EXTERN void timestamp_start(void);
+T_EXTERN void timestamp_enable_uptime(void);
+T_EXTERN void timestamp_now(struct timespec *ts, struct timespec *uptime);
+T_EXTERN tuint32 timestamp_new_id(void);
+T_EXTERN const tchar *timestamp_render(tuint32 id, const tchar *format,
+        time_t sec, tuint32 *len);
+T_EXTERN tbool timestamp_localtime(time_t sec, struct tm *tm);
+T_EXTERN void timestamp_utc(time_t sec, struct tm *tm);
+T_EXTERN void timestamp_iso_utc(time_t sec, tchar *buf);
+
+T_END_DECLS
+
+#endif /* _TIMESTAMP_H_ */
@@ -444,7 +444,7 @@ static kv_node *t_keyfile_find_kv(const tkeyfile *keyfile, const tchar *group,
         const tchar *key)
 {
     group_node *group_n = t_keyfile_find_group(keyfile, group);
-    if (NULL != group_n)
+    if ((NULL != group_n) && (NULL != group_n->kv))
     {
         thash_string_node *hash_node = t_hash_string_get(group_n->kv, key);
         if (NULL != hash_node)
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <time.h>
 #include "../include/tlog/tlog.h"
 #include "ttypes.h"
 #include "tassert.h"
@@ -18,11 +19,15 @@
 #include "tslist.h"
 #include "tstring.h"
 #include "level.h"
+#include "tbuffer.h"
 #include "format.h"
 #include "rules.h"
 #include "category.h"
 #include "mdc.h"
+#include "async.h"
+#include "flusher.h"
 #include "global.h"
+#include "timestamp.h"
 
 /****************************************************
  * macros definition
@@ -41,6 +46,20 @@ static thash_string *formats_kv = NULL;
 static thash_string *category_detail = NULL;
 /* mdc */
 static mdc *mdc_map = NULL;
+/* async logger, NULL means synchronous output */
+static async_logger *async_handle = NULL;
+/* format message in writer thread */
+static tbool deferred_format = FALSE;
+/* background file sync, NULL means never sync */
+static flusher *sync_flusher = NULL;
+/* file sync interval in millisecond, 0 means no interval sync */
+static tuint32 sync_interval = 0;
+/* sync file when dirty bytes reach it, 0 means no threshold sync */
+static tuint32 sync_bytes = 0;
+/* size based file rotating, NULL means no rule has size limit */
+static flusher *rotate_flusher = NULL;
+/* flush aged rule buffers, NULL means no rule has flush age */
+static flusher *age_flusher = NULL;
 
 /* default configure file */
 static const tchar default_cfg[] = "[general]\n[format]\n[rules]\n*.*=>stdout";
@@ -48,6 +67,33 @@ static const tchar default_cfg[] = "[general]\n[format]\n[rules]\n*.*=>stdout";
 /****************************************************
  * functions 
  ****************************************************/
+/**
+ * @brief sync dirty file outputs, called in flusher thread
+ * @param userdata - userdata
+ */
+static void sync_files(void *userdata)
+{
+    categories_sync(category_detail, NULL != async_handle);
+}
+
+/**
+ * @brief rotate replaced files, called in rotate thread
+ * @param userdata - userdata
+ */
+static void rotate_files(void *userdata)
+{
+    categories_rotate(category_detail);
+}
+
+/**
+ * @brief flush aged rule buffers, called in flusher thread
+ * @param userdata - userdata
+ */
+static void flush_aged(void *userdata)
+{
+    categories_flush_aged(category_detail);
+}
+
 /**
  * @brief filter general group
  * @param keyfile - keyfile handle
@@ -58,8 +104,43 @@ static tint filter_group_general(tkeyfile *keyfile)
     T_ASSERT(NULL != keyfile);
 
     tint err = 0;
+    timestamp_set_coarse(FALSE);
+    sync_interval = 0;
+    sync_bytes = 0;
     if (t_keyfile_contains_group(keyfile, GROUP_NAME_GENRAL))
     {
+        timestamp_set_coarse(t_keyfile_get_bool(keyfile, GROUP_NAME_GENRAL,
+                    GENERAL_KEY_COARSE_CLOCK, FALSE));
+
+        if (t_keyfile_get_bool(keyfile, GROUP_NAME_GENRAL, GENERAL_KEY_ASYNC, FALSE))
+        {
+            tint ring_size = t_keyfile_get_int(keyfile, GROUP_NAME_GENRAL,
+                    GENERAL_KEY_ASYNC_BUFFER, DEFAULT_ASYNC_BUFFER_SIZE);
+            if (ring_size <= 0)
+            {
+                return -EINVAL;
+            }
+
+            async_handle = async_new(ring_size);
+            if (NULL == async_handle)
+            {
+                return -ENOMEM;
+            }
+
+            deferred_format = t_keyfile_get_bool(keyfile, GROUP_NAME_GENRAL,
+                    GENERAL_KEY_DEFERRED_FORMAT, FALSE);
+        }
+
+        tint interval = t_keyfile_get_int(keyfile, GROUP_NAME_GENRAL,
+                GENERAL_KEY_SYNC_INTERVAL, 0);
+        tint bytes = t_keyfile_get_int(keyfile, GROUP_NAME_GENRAL,
+                GENERAL_KEY_SYNC_BYTES, 0);
+        if ((interval < 0) || (bytes < 0))
+        {
+            return -EINVAL;
+        }
+        sync_interval = (tuint32)interval;
+        sync_bytes = (tuint32)bytes;
     }
 
     return err;
@@ -107,6 +188,38 @@ static tint filter_config_file(tkeyfile *keyfile)
         return err;
     }
 
+    /* start after category table is complete */
+    if ((0 != sync_interval) || (0 != sync_bytes))
+    {
+        sync_flusher = flusher_new(sync_interval, sync_files, NULL);
+        if (NULL == sync_flusher)
+        {
+            return -ENOMEM;
+        }
+        categories_set_flusher(sync_flusher, sync_bytes);
+    }
+
+    if (categories_need_rotate(category_detail))
+    {
+        rotate_flusher = flusher_new(0, rotate_files, NULL);
+        if (NULL == rotate_flusher)
+        {
+            return -ENOMEM;
+        }
+        categories_set_rotator(rotate_flusher);
+    }
+
+    /* checked twice per smallest age, buffered age is at most 1.5 times of it */
+    tuint32 age = categories_min_flush_age(category_detail);
+    if (0 != age)
+    {
+        age_flusher = flusher_new(MAX(age / 2, 1), flush_aged, NULL);
+        if (NULL == age_flusher)
+        {
+            return -ENOMEM;
+        }
+    }
+
     return 0;
 }
 
@@ -177,6 +290,7 @@ tint tlog_open(const tchar *name, tlog_source source)
 
     if (0 == ret)
     {
+        timestamp_start();
         ret = tlog_internal_init(keyfile);
         if (0 == ret)
         {
@@ -200,6 +314,37 @@ tint tlog_open(const tchar *name, tlog_source source)
  */
 void tlog_close()
 {
+    /* write all pending records before close output */
+    if (NULL != async_handle)
+    {
+        async_free(async_handle);
+    }
+
+    if (NULL != age_flusher)
+    {
+        flusher_free(age_flusher);
+        age_flusher = NULL;
+    }
+
+    /* finish pending rotating, replaced files are synced if needed */
+    if (NULL != rotate_flusher)
+    {
+        categories_set_rotator(NULL);
+        flusher_free(rotate_flusher);
+        rotate_flusher = NULL;
+    }
+
+    /* sync written records before close output */
+    if (NULL != sync_flusher)
+    {
+        categories_set_flusher(NULL, 0);
+        flusher_free(sync_flusher);
+        sync_flusher = NULL;
+    }
+
+    async_handle = NULL;
+    deferred_format = FALSE;
+
     if (NULL != category_detail)
     {
         category_free(category_detail);
@@ -236,27 +381,136 @@ const tlog_category *tlog_get_category(const tchar *name)
 /**
  * @brief log real output function
  * @param cat - log category handle
- * @param file - file name
- * @param line - log generate line
- * @param func - function name
- * @param level - log level
+ * @param site - static call site information
  * @param fmt - user log message
  */
-void tlog(const tlog_category *cat, const char *file,
-        long line, const char *func, const tchar *line_str,
-        int level, const char *fmt, ...)
+void tlog(const tlog_category *cat, const tlog_callsite *site,
+        const char *fmt, ...)
 {
-    if (NULL != cat)
+    if ((NULL != site) && tlog_enabled(cat, site->level))
     {
-        tchar user_msg[256] = {0};
         va_list args;
         va_start(args, fmt);
-        vsprintf(user_msg, fmt, args);
-        category_gen_log(cat, file, line, func, line_str, level, user_msg, mdc_map);
+        if (!deferred_format || 
+            !category_defer_log(cat, site, fmt, args, async_handle))
+        {
+            category_gen_log(cat, site, fmt, args, mdc_map, async_handle);
+        }
         va_end(args);
     }
 }
 
+/**
+ * @brief check call site rate limit, token bucket refilled with per_sec
+ *        tokens per second and holds at most burst tokens
+ * @param limit - call site limit state
+ * @param per_sec - output records per second, 0 means suppress all
+ * @param burst - max records output at once
+ * @param suppressed - suppressed record count since last output
+ * @return 1: output, 0: suppressed
+ */
+int tlog_ratelimit_check(tlog_limit *limit, unsigned int per_sec,
+        unsigned int burst, unsigned long *suppressed)
+{
+    if (0 == per_sec)
+    {
+        __atomic_fetch_add(&limit->suppressed, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    if (0 == burst)
+    {
+        burst = 1;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    tuint64 now = (tuint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    tuint64 interval = 1000000000ULL / per_sec;
+
+    /* generic cell rate algorithm, no lock needed */
+    unsigned long long tat = __atomic_load_n(&limit->tat, __ATOMIC_RELAXED);
+    unsigned long long new_tat;
+    do
+    {
+        new_tat = ((tat > now) ? tat : now) + interval;
+        if (new_tat - now > interval * burst)
+        {
+            __atomic_fetch_add(&limit->suppressed, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&limit->tat, &tat, new_tat, TRUE,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/**
+ * @brief rate limited log output function
+ * @param cat - log category handle
+ * @param site - static call site information
+ * @param suppressed - suppressed record count, appended to message
+ * @param fmt - user message format
+ */
+void tlog_limited(const tlog_category *cat, const tlog_callsite *site,
+        unsigned long suppressed, const char *fmt, ...)
+{
+    if ((NULL == site) || !tlog_enabled(cat, site->level))
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    if (0 == suppressed)
+    {
+        if (!deferred_format || 
+            !category_defer_log(cat, site, fmt, args, async_handle))
+        {
+            category_gen_log(cat, site, fmt, args, mdc_map, async_handle);
+        }
+    }
+    else
+    {
+        /* rarely happened, render message with suppressed count here */
+        tbuffer msg;
+        t_buffer_init(&msg);
+        if (0 == t_buffer_vprintf(&msg, fmt, args))
+        {
+            tchar count[24];
+            t_string_from_uint(count, suppressed);
+            if ((0 == t_buffer_append(&msg, " (suppressed ", 13)) &&
+                (0 == t_buffer_append(&msg, count, strlen(count))) &&
+                (0 == t_buffer_append_char(&msg, ')', 1)))
+            {
+                category_gen_kv_log(cat, site, msg.data, NULL, 0, mdc_map,
+                        async_handle);
+            }
+        }
+        t_buffer_free(&msg);
+    }
+    va_end(args);
+}
+
+/**
+ * @brief structured log output function
+ * @param cat - log category handle
+ * @param site - static call site information
+ * @param msg - user log message, not formatted
+ * @param fields - structured fields
+ * @param count - field count
+ */
+void tlog_kv_write(const tlog_category *cat, const tlog_callsite *site,
+        const char *msg, const tlog_field *fields, unsigned int count)
+{
+    if ((NULL != site) && tlog_enabled(cat, site->level))
+    {
+        category_gen_kv_log(cat, site, msg, fields, count, mdc_map,
+                async_handle);
+    }
+}
+
 /**
  * @brief put mdc key-value to hash table
  * @param key - key string
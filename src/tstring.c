@@ -21,6 +21,32 @@
 /****************************************************
  * static variable 
  ****************************************************/
+/* two digits table, convert two digits at once */
+static const tchar digits_table[201] = 
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* two hexadecimal digits lookup table, 00 - ff */
+static const tchar hex_table[513] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
 
 /****************************************************
  * functions 
@@ -626,3 +652,125 @@ tint32 t_string_get_line(tchar *out, const tchar *buf, tuint32 max_size, tuint32
     return out - head;
 }
 
+/**
+ * @brief get decimal digit count of unsigned integer
+ * @param value - integer value
+ * @return digit count
+ */
+static inline tuint32 uint_digits(tuint64 value)
+{
+    tuint32 count = 1;
+    for (;;)
+    {
+        if (value < 10)
+        {
+            return count;
+        }
+        if (value < 100)
+        {
+            return count + 1;
+        }
+        if (value < 1000)
+        {
+            return count + 2;
+        }
+        if (value < 10000)
+        {
+            return count + 3;
+        }
+        value /= 10000;
+        count += 4;
+    }
+}
+
+/**
+ * @brief convert unsigned integer to decimal string
+ * @param buf - output buffer, at least 21 bytes
+ * @param value - integer value
+ * @return string length
+ */
+tuint32 t_string_from_uint(tchar *buf, tuint64 value)
+{
+    T_ASSERT(NULL != buf);
+
+    /* length is known first, so digits are written in place */
+    tuint32 len = uint_digits(value);
+    tchar *pos = buf + len;
+    *pos = '\0';
+    while (value >= 100)
+    {
+        const tchar *digits = digits_table + (value % 100) * 2;
+        value /= 100;
+        *--pos = digits[1];
+        *--pos = digits[0];
+    }
+
+    if (value >= 10)
+    {
+        const tchar *digits = digits_table + value * 2;
+        *--pos = digits[1];
+        *--pos = digits[0];
+    }
+    else
+    {
+        *--pos = '0' + value;
+    }
+
+    return len;
+}
+
+/**
+ * @brief convert unsigned integer to lower case hexadecimal string,
+ *        no prefix
+ * @param buf - output buffer, at least 17 bytes
+ * @param value - integer value
+ * @return string length
+ */
+tuint32 t_string_from_hex(tchar *buf, tuint64 value)
+{
+    T_ASSERT(NULL != buf);
+
+    /* 4 bits every digit, 0 still has one digit */
+    tuint32 len = (0 == value) ? 1 : (67 - __builtin_clzll(value)) / 4;
+    tchar *pos = buf + len;
+    *pos = '\0';
+    while (value >= 0x100)
+    {
+        const tchar *digits = hex_table + (value & 0xff) * 2;
+        value >>= 8;
+        *--pos = digits[1];
+        *--pos = digits[0];
+    }
+
+    if (value >= 0x10)
+    {
+        const tchar *digits = hex_table + value * 2;
+        *--pos = digits[1];
+        *--pos = digits[0];
+    }
+    else
+    {
+        *--pos = hex_table[value * 2 + 1];
+    }
+
+    return len;
+}
+
+/**
+ * @brief convert signed integer to decimal string
+ * @param buf - output buffer, at least 21 bytes
+ * @param value - integer value
+ * @return string length
+ */
+tuint32 t_string_from_int(tchar *buf, tint64 value)
+{
+    T_ASSERT(NULL != buf);
+
+    if (value < 0)
+    {
+        *buf = '-';
+        return t_string_from_uint(buf + 1, (tuint64)0 - (tuint64)value) + 1;
+    }
+
+    return t_string_from_uint(buf, value);
+}
@@ -31,6 +31,9 @@ T_EXTERN tbool t_string_to_int(const tchar *str, tint *out);
 T_EXTERN tbool t_string_to_bool(const tchar *str, tbool *out);
 T_EXTERN void t_string_remove_linebreak(const tchar *str, tchar *out);
 T_EXTERN tint32 t_string_get_line(tchar *out, const tchar *buf, tuint32 max_size, tuint32 index);
+T_EXTERN tuint32 t_string_from_uint(tchar *buf, tuint64 value);
+T_EXTERN tuint32 t_string_from_int(tchar *buf, tint64 value);
+T_EXTERN tuint32 t_string_from_hex(tchar *buf, tuint64 value);
 
 
 
@@ -0,0 +1,97 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/format.h"
+
+/*
+ * format engine benchmark, not a test case
+ * usage: bench_format [records]
+ */
+
+static const char *formats[] =
+{
+    "%d(%F %T) %-6V [%F:%L:%U] %m%n",
+    "%d(%Y-%m-%d %T).%S %6V [pid:%p tid:%t] [%f:%U:%L] %m%n",
+    "[%V] [svc:demo] [%f:%L] <%U> %m | %%done%%%n",
+    "%D %v %m%n",
+    "%D %v %q%n",
+    "%E [%r] %v %m%n",
+    "%j%n",
+    "[pid:%p] [svc:%c] [%f:%L] %m%n",
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* render records, return ns per record */
+static double bench(tbuffer *buf, const split_format *splits, preprocess_info *pre,
+        long records)
+{
+    double start = now_ns();
+    for (long n = 0; n < records; ++n)
+    {
+        /* new second every 1000 records */
+        pre->ts.tv_sec = 1500000000 + n / 1000;
+        pre->ts.tv_nsec = (n % 1000) * 1000000;
+        t_buffer_clear(buf);
+        format_split_to_string(buf, splits, pre);
+    }
+
+    return (now_ns() - start) / records;
+}
+
+int main(int argc, char **argv)
+{
+    long records = (argc > 1) ? atol(argv[1]) : 2000000;
+    static const tlog_callsite site =
+    {
+        "/path/to/source/bench_format.c", "bench_format.c", "main", "42", 42, TLOG_INFO
+    };
+
+    tbuffer buf, msg_buf;
+    t_buffer_init(&buf);
+    t_buffer_init(&msg_buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.user_msg = "connection from 10.0.0.1 accepted";
+    pre.msg_buf = &msg_buf;
+
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+    {
+        split_format *splits = format_to_split(formats[i]);
+        if (NULL == splits)
+        {
+            fprintf(stderr, "invalid format: %s\n", formats[i]);
+            return 1;
+        }
+
+        /* rule attached format, process constants folded */
+        split_format *folded = format_split_fold(splits, "bench", identity_current());
+        if (NULL == folded)
+        {
+            fprintf(stderr, "fold failed: %s\n", formats[i]);
+            return 1;
+        }
+
+        double plain = bench(&buf, splits, &pre, records);
+        double fold = bench(&buf, folded, &pre, records);
+        printf("%-58s %8.1f ns/record %8.1f folded\n", formats[i], plain, fold);
+        split_format_free(folded);
+        split_format_free(splits);
+    }
+
+    t_buffer_free(&buf);
+    t_buffer_free(&msg_buf);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/tstring.h"
+
+/*
+ * integer rendering benchmark, t_string_from_xxx against snprintf,
+ * not a test case
+ * usage: bench_itoa [count]
+ */
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* keeps result alive */
+static volatile unsigned long sink;
+
+int main(int argc, char **argv)
+{
+    long count = (argc > 1) ? atol(argv[1]) : 10000000;
+    /* line number, pid and pthread_t like values */
+    static const unsigned long values[] =
+    {
+        7, 42, 318, 1024, 65535, 140737351968512UL, 139876543210496UL, 4294967295UL
+    };
+    const long value_count = sizeof(values) / sizeof(values[0]);
+    char buf[24];
+
+    double start = now_ns();
+    for (long n = 0; n < count; ++n)
+    {
+        sink += snprintf(buf, sizeof(buf), "%lu", values[n % value_count]);
+    }
+    double snprintf_dec = (now_ns() - start) / count;
+
+    start = now_ns();
+    for (long n = 0; n < count; ++n)
+    {
+        sink += t_string_from_uint(buf, values[n % value_count]);
+    }
+    double fast_dec = (now_ns() - start) / count;
+
+    start = now_ns();
+    for (long n = 0; n < count; ++n)
+    {
+        sink += snprintf(buf, sizeof(buf), "%lx", values[n % value_count]);
+    }
+    double snprintf_hex = (now_ns() - start) / count;
+
+    start = now_ns();
+    for (long n = 0; n < count; ++n)
+    {
+        sink += t_string_from_hex(buf, values[n % value_count]);
+    }
+    double fast_hex = (now_ns() - start) / count;
+
+    printf("decimal  snprintf %6.1f ns  t_string_from_uint %6.1f ns\n",
+            snprintf_dec, fast_dec);
+    printf("hex      snprintf %6.1f ns  t_string_from_hex  %6.1f ns\n",
+            snprintf_hex, fast_hex);
+
+    return 0;
+}
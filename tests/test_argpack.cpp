@@ -0,0 +1,144 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+#include <sys/mman.h>
+#include "gtest/gtest.h"
+#include "../src/argpack.h"
+
+static char packed[1024] __attribute__((aligned(8)));
+static char expect[1024];
+static char result[1024];
+
+/* pack and render, result must be the same as vsnprintf */
+static int check_render(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int size = argpack_size(fmt, args);
+    va_end(args);
+
+    va_start(args, fmt);
+    int pack_size = argpack_pack(packed, fmt, args);
+    va_end(args);
+
+    va_start(args, fmt);
+    vsnprintf(expect, sizeof(expect), fmt, args);
+    va_end(args);
+
+    EXPECT_EQ(size, pack_size);
+    if (size >= 0)
+    {
+        argpack_render(result, sizeof(result), fmt, packed, size);
+    }
+
+    return size;
+}
+
+TEST(ArgpackTest, Render)
+{
+    EXPECT_EQ(0, check_render("no argument"));
+    EXPECT_STREQ(expect, result);
+
+    EXPECT_LT(0, check_render("%d %i %u %x %X %o %c %%", -1, 2, 3u, 0xab, 0xcd, 8, 'a'));
+    EXPECT_STREQ(expect, result);
+
+    EXPECT_LT(0, check_render("%hhd %hd %ld %lld %zu %jd %td", (char)-1, (short)-2,
+                -3L, -4LL, (size_t)5, (intmax_t)-6, (ptrdiff_t)7));
+    EXPECT_STREQ(expect, result);
+
+    EXPECT_LT(0, check_render("%-8d|%08.3f|%*d|%.*s|%*.*e", 12, 3.14159, 6, 42,
+                3, "abcdef", 12, 2, 1234.5));
+    EXPECT_STREQ(expect, result);
+
+    EXPECT_LT(0, check_render("%s %s %Lf %p", "string", (char *)NULL, 1.5L, (void *)packed));
+    EXPECT_STREQ(expect, result);
+
+    EXPECT_LT(0, check_render("%ls %lc", L"wide", (wint_t)L'w'));
+    EXPECT_STREQ(expect, result);
+
+    errno = ENOENT;
+    EXPECT_LT(0, check_render("error: %m"));
+    EXPECT_STREQ(expect, result);
+}
+
+TEST(ArgpackTest, DeepCopy)
+{
+    char str[16] = "before";
+    check_render("%s", str);
+    strcpy(str, "after");
+    argpack_render(result, sizeof(result), "%s", packed, sizeof(packed));
+    EXPECT_STREQ("before", result);
+}
+
+TEST(ArgpackTest, Truncate)
+{
+    check_render("%s-%d", "abcdef", 123);
+    char buf[5];
+    EXPECT_EQ(10, argpack_render(buf, sizeof(buf), "%s-%d", packed, sizeof(packed)));
+    EXPECT_STREQ("abcd", buf);
+}
+
+TEST(ArgpackTest, Precision)
+{
+    /* string ends right before an inaccessible page, no terminator */
+    long page = sysconf(_SC_PAGESIZE);
+    char *mem = (char *)mmap(NULL, page * 2, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, (void *)mem);
+    ASSERT_EQ(0, mprotect(mem + page, page, PROT_NONE));
+    char *str = mem + page - 4;
+    memcpy(str, "abcd", 4);
+    EXPECT_LT(0, check_render("%.*s|%.4s|%.2s|%.*s", 4, str, str, str, -1, "all"));
+    EXPECT_STREQ(expect, result);
+    EXPECT_STREQ("abcd|abcd|ab|all", result);
+
+    wchar_t *wstr = (wchar_t *)(mem + page) - 2;
+    wstr[0] = L'w';
+    wstr[1] = L'x';
+    EXPECT_LT(0, check_render("%.*ls|%.2ls", 2, wstr, wstr));
+    EXPECT_STREQ(expect, result);
+
+    munmap(mem, page * 2);
+}
+
+TEST(ArgpackTest, Mismatch)
+{
+    int size = check_render("%s %d", "abcdef", 123);
+    ASSERT_LT(0, size);
+    EXPECT_EQ(-1, argpack_render(result, sizeof(result), "%s %d", packed, size - 1));
+    EXPECT_EQ(-1, argpack_render(result, sizeof(result), "%s %d %s", packed, size));
+    EXPECT_EQ(-1, argpack_render(NULL, 0, "%s", packed, 3));
+
+    /* string length larger than pack */
+    tuint32 len = 1000;
+    memcpy(packed, &len, sizeof(len));
+    EXPECT_EQ(-1, argpack_render(result, sizeof(result), "%s", packed, 16));
+
+    /* string not terminated */
+    len = 3;
+    memcpy(packed, &len, sizeof(len));
+    memcpy(packed + 8, "abc", 3);
+    EXPECT_EQ(-1, argpack_render(result, sizeof(result), "%s", packed, 16));
+}
+
+TEST(ArgpackTest, Unsupported)
+{
+    EXPECT_EQ(-1, check_render("%1$d", 1));
+    EXPECT_EQ(-1, check_render("%y"));
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
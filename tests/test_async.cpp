@@ -0,0 +1,223 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "gtest/gtest.h"
+#include "../src/async.h"
+
+#define THREAD_COUNT    4
+#define RECORD_COUNT    10000
+
+async_logger *g_async = NULL;
+FILE *g_fd = NULL;
+
+static void *push_thread(void *arg)
+{
+    char buf[32];
+    long index = (long)arg;
+    for (int i = 0; i < RECORD_COUNT; ++i)
+    {
+        int len = sprintf(buf, "%ld %d\n", index, i);
+        async_push(g_async, g_fd, buf, len);
+    }
+    pthread_exit((void *)0);
+}
+
+#ifdef T_ENABLE_ASSERT
+TEST(AsyncTest, Death)
+{
+    ASSERT_DEATH(async_free(NULL), "");
+}
+#endif
+
+TEST(AsyncTest, Function)
+{
+    g_fd = tmpfile();
+    ASSERT_NE((void *)0, g_fd);
+    g_async = async_new(4096);
+    ASSERT_NE((void *)0, g_async);
+
+    pthread_t tid[THREAD_COUNT];
+    for (long i = 0; i < THREAD_COUNT; ++i)
+    {
+        pthread_create(&tid[i], NULL, push_thread, (void *)i);
+    }
+
+    for (int i = 0; i < THREAD_COUNT; ++i)
+    {
+        pthread_join(tid[i], NULL);
+    }
+
+    /* large record goes around the ring */
+    char large[8192];
+    memset(large, 'a', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\n';
+    async_push(g_async, g_fd, large, sizeof(large));
+    async_free(g_async);
+
+    /* records of every thread must be in order */
+    rewind(g_fd);
+    int next[THREAD_COUNT] = {0};
+    long index = 0;
+    int value = 0;
+    int count = 0;
+    int large_count = 0;
+    char line[sizeof(large) + 1];
+    while (NULL != fgets(line, sizeof(line), g_fd))
+    {
+        if (sizeof(large) == strlen(line))
+        {
+            large_count ++;
+            continue;
+        }
+
+        ASSERT_EQ(2, sscanf(line, "%ld %d", &index, &value));
+        ASSERT_LT(index, THREAD_COUNT);
+        EXPECT_EQ(next[index], value);
+        next[index] = value + 1;
+        count ++;
+    }
+    EXPECT_EQ(THREAD_COUNT * RECORD_COUNT, count);
+    EXPECT_EQ(1, large_count);
+    fclose(g_fd);
+}
+
+/* push records in order and check all of them are written in order */
+static void check_batch(FILE *fd, char **data, size_t *size)
+{
+    async_logger *async = async_new(1024 * 1024);
+    ASSERT_NE((void *)0, async);
+    char buf[1024];
+    for (int i = 0; i < RECORD_COUNT; ++i)
+    {
+        int len = sprintf(buf, "batch record %d ", i);
+        memset(buf + len, 'x', sizeof(buf) - len - 1);
+        buf[sizeof(buf) - 1] = '\n';
+        async_push(async, fd, buf, sizeof(buf));
+    }
+    async_free(async);
+    fflush(fd);
+
+    if (NULL == data)
+    {
+        rewind(fd);
+    }
+    else
+    {
+        /* memory stream */
+        fclose(fd);
+        fd = fmemopen(*data, *size, "r");
+        ASSERT_NE((void *)0, fd);
+    }
+
+    int value = 0;
+    int count = 0;
+    while (1 == fscanf(fd, "batch record %d %*[x]\n", &value))
+    {
+        ASSERT_EQ(count, value);
+        count ++;
+    }
+    EXPECT_EQ(RECORD_COUNT, count);
+    fclose(fd);
+}
+
+TEST(AsyncTest, Batch)
+{
+    /* large batches are written by writev */
+    FILE *fd = tmpfile();
+    ASSERT_NE((void *)0, fd);
+    check_batch(fd, NULL, NULL);
+
+    /* stream without file descriptor */
+    char *data = NULL;
+    size_t size = 0;
+    fd = open_memstream(&data, &size);
+    ASSERT_NE((void *)0, fd);
+    check_batch(fd, &data, &size);
+    free(data);
+}
+TEST(AsyncTest, Flush)
+{
+    FILE *fd = tmpfile();
+    ASSERT_NE((void *)0, fd);
+    ASSERT_EQ(0, setvbuf(fd, NULL, _IOFBF, 1024 * 1024));
+    async_logger *async = async_new(4096);
+    ASSERT_NE((void *)0, async);
+
+    /* buffered record reaches file after flush mark is written */
+    async_push(async, fd, "flushed\n", 8);
+    async_flush(async, fd);
+    struct stat st;
+    for (int i = 0; i < 2000; ++i)
+    {
+        ASSERT_EQ(0, fstat(fileno(fd), &st));
+        if (8 == st.st_size)
+        {
+            break;
+        }
+        usleep(1000);
+    }
+    EXPECT_EQ(8, st.st_size);
+
+    async_free(async);
+    fclose(fd);
+}
+
+static volatile int slow_started = 0;
+
+/* deferred write blocking like slow disk */
+static void slow_write(const char *data, unsigned int len)
+{
+    slow_started = 1;
+    usleep(500000);
+}
+
+static void *first_push_thread(void *arg)
+{
+    async_push((async_logger *)arg, g_fd, "new\n", 4);
+    pthread_exit((void *)0);
+}
+
+TEST(AsyncTest, SlowOutput)
+{
+    g_fd = tmpfile();
+    ASSERT_NE((void *)0, g_fd);
+    async_logger *async = async_new(4096);
+    ASSERT_NE((void *)0, async);
+
+    async_reserve(async, 8);
+    async_commit(async, slow_write);
+    while (!slow_started)
+    {
+        usleep(1000);
+    }
+
+    /* first record of new thread does not wait for writer output */
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t tid;
+    pthread_create(&tid, NULL, first_push_thread, async);
+    pthread_join(tid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    EXPECT_GT(250, ms);
+
+    async_free(async);
+    fclose(g_fd);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    testing::FLAGS_gtest_death_test_style = "fast";
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,322 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <string>
+#include "gtest/gtest.h"
+#include "../src/binary.h"
+
+#define TEST_FORMAT "%d(%Y-%m-%d %T).%S %6V [%p:%t] [%F:%f:%U:%L] %m%n"
+
+static const tlog_callsite site1 = {"/path/to/file1.c", NULL, "func1", "10", 10, TLOG_LEVEL_INFO};
+static const tlog_callsite site2 = {"file2.c", "file2.c", "func2", "20", 20, TLOG_LEVEL_ERROR};
+
+/* encode record to binary and render same record to text */
+static void encode(binary_writer *writer, split_format *splits, tbuffer *bin,
+        tbuffer *text, const tlog_callsite *site, const char *fmt, ...)
+{
+    tbuffer msg;
+    t_buffer_init(&msg);
+
+    va_list args;
+    va_start(args, fmt);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = site;
+    pre.fmt = fmt;
+    pre.args = &args;
+    pre.msg_buf = &msg;
+    clock_gettime(CLOCK_REALTIME, &pre.ts);
+    EXPECT_EQ(0, binary_encode(writer, bin, &pre));
+    va_end(args);
+
+    va_start(args, fmt);
+    format_split_to_string(text, splits, &pre);
+    va_end(args);
+
+    t_buffer_free(&msg);
+}
+
+TEST(BinaryTest, Decode)
+{
+    binary_writer *writer = binary_new();
+    ASSERT_NE((void *)0, writer);
+    split_format *splits = format_to_split(TEST_FORMAT);
+    ASSERT_NE((void *)0, splits);
+
+    tbuffer bin, text, out;
+    t_buffer_init(&bin);
+    t_buffer_init(&text);
+    t_buffer_init(&out);
+
+    ASSERT_EQ(0, binary_write_header(&bin, TEST_FORMAT));
+    encode(writer, splits, &bin, &text, &site1, "value %d %s %.2f", 42, "str", 3.14159);
+    encode(writer, splits, &bin, &text, &site2, "no argument");
+    encode(writer, splits, &bin, &text, &site1, "value %d %s %.2f", -1, "again", 2.5);
+    /* unsupported conversion is stored as rendered text */
+    encode(writer, splits, &bin, &text, &site2, "%1$d positional", 7);
+
+    /* call site dictionary is written once */
+    tuint32 site_len = bin.len;
+    encode(writer, splits, &bin, &text, &site2, "no argument");
+    tbuffer tmp;
+    t_buffer_init(&tmp);
+    encode(writer, splits, &tmp, &text, &site2, "no argument");
+    EXPECT_EQ(bin.len - site_len, tmp.len);
+    t_buffer_append(&bin, tmp.data, tmp.len);
+    t_buffer_free(&tmp);
+
+    /* appended file starts a new segment */
+    binary_writer *writer2 = binary_new();
+    ASSERT_NE((void *)0, writer2);
+    ASSERT_EQ(0, binary_write_header(&bin, TEST_FORMAT));
+    encode(writer2, splits, &bin, &text, &site2, "second %s", "segment");
+    binary_free(writer2);
+
+    EXPECT_EQ(0, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(std::string(text.data, text.len), std::string(out.data, out.len));
+
+    /* truncated data */
+    t_buffer_clear(&out);
+    EXPECT_EQ(-EINVAL, binary_decode(bin.data, bin.len - 1, &out));
+    EXPECT_EQ(-EINVAL, binary_decode("garbage", 7, &out));
+
+    t_buffer_free(&bin);
+    t_buffer_free(&text);
+    t_buffer_free(&out);
+    split_format_free(splits);
+    binary_free(writer);
+}
+
+TEST(BinaryTest, Message)
+{
+    binary_writer *writer = binary_new();
+    ASSERT_NE((void *)0, writer);
+
+    tbuffer bin, out;
+    t_buffer_init(&bin);
+    t_buffer_init(&out);
+
+    /* rendered message, such as structured log */
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site1;
+    pre.user_msg = "plain message";
+    clock_gettime(CLOCK_REALTIME, &pre.ts);
+    ASSERT_EQ(0, binary_write_header(&bin, "%V %m%n"));
+    ASSERT_EQ(0, binary_encode(writer, &bin, &pre));
+
+    EXPECT_EQ(0, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(std::string("INFO plain message\n"), std::string(out.data, out.len));
+
+    t_buffer_free(&bin);
+    t_buffer_free(&out);
+    binary_free(writer);
+}
+
+TEST(BinaryTest, RuntimeFormat)
+{
+    binary_writer *writer = binary_new();
+    ASSERT_NE((void *)0, writer);
+    split_format *splits = format_to_split("%m%n");
+    ASSERT_NE((void *)0, splits);
+
+    tbuffer bin, text, out;
+    t_buffer_init(&bin);
+    t_buffer_init(&text);
+    t_buffer_init(&out);
+
+    /* format built at runtime, buffer is reused with other content */
+    ASSERT_EQ(0, binary_write_header(&bin, "%m%n"));
+    char *fmt = (char *)malloc(32);
+    ASSERT_NE((void *)0, fmt);
+    strcpy(fmt, "first %d");
+    encode(writer, splits, &bin, &text, &site1, fmt, 1);
+    strcpy(fmt, "second %s");
+    encode(writer, splits, &bin, &text, &site1, fmt, "str");
+    strcpy(fmt, "first %d");
+    encode(writer, splits, &bin, &text, &site1, fmt, 3);
+    free(fmt);
+
+    /* same content in another buffer hits dictionary */
+    tbuffer tmp;
+    t_buffer_init(&tmp);
+    encode(writer, splits, &tmp, &text, &site1, "first %d", 4);
+    EXPECT_EQ((tuint8)'R', (tuint8)tmp.data[0]);
+    t_buffer_append(&bin, tmp.data, tmp.len);
+    t_buffer_free(&tmp);
+
+    EXPECT_EQ(0, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(std::string("first 1\nsecond str\nfirst 3\nfirst 4\n"),
+            std::string(out.data, out.len));
+    EXPECT_EQ(std::string(text.data, text.len), std::string(out.data, out.len));
+
+    t_buffer_free(&bin);
+    t_buffer_free(&text);
+    t_buffer_free(&out);
+    split_format_free(splits);
+    binary_free(writer);
+}
+
+/* encode records of two call sites from one thread */
+typedef struct
+{
+    binary_writer *writer;
+    split_format *splits;
+    tbuffer bin;
+    tbuffer text;
+}encode_thread_data;
+
+static void *encode_thread(void *arg)
+{
+    encode_thread_data *data = (encode_thread_data *)arg;
+    for (int i = 0; i < 100; ++i)
+    {
+        encode(data->writer, data->splits, &data->bin, &data->text, &site1, "first %d", i);
+        encode(data->writer, data->splits, &data->bin, &data->text, &site2, "second %d", i);
+    }
+    return NULL;
+}
+
+TEST(BinaryTest, Threads)
+{
+    binary_writer *writer = binary_new();
+    ASSERT_NE((void *)0, writer);
+    split_format *splits = format_to_split("%m%n");
+    ASSERT_NE((void *)0, splits);
+
+    encode_thread_data data[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        data[i].writer = writer;
+        data[i].splits = splits;
+        t_buffer_init(&data[i].bin);
+        t_buffer_init(&data[i].text);
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, encode_thread, &data[i]));
+    }
+
+    /* call site written by one thread is used by records of others */
+    tbuffer bin, text, out;
+    t_buffer_init(&bin);
+    t_buffer_init(&text);
+    t_buffer_init(&out);
+    ASSERT_EQ(0, binary_write_header(&bin, "%m%n"));
+    for (int i = 0; i < 4; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        t_buffer_append(&bin, data[i].bin.data, data[i].bin.len);
+        t_buffer_append(&text, data[i].text.data, data[i].text.len);
+        t_buffer_free(&data[i].bin);
+        t_buffer_free(&data[i].text);
+    }
+
+    EXPECT_EQ(0, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(std::string(text.data, text.len), std::string(out.data, out.len));
+
+    t_buffer_free(&bin);
+    t_buffer_free(&text);
+    t_buffer_free(&out);
+    split_format_free(splits);
+    binary_free(writer);
+}
+
+/* append raw entry fields */
+static void put_u32(tbuffer *buf, tuint32 value)
+{
+    t_buffer_append(buf, (const char *)&value, sizeof(value));
+}
+
+static void put_u64(tbuffer *buf, tuint64 value)
+{
+    t_buffer_append(buf, (const char *)&value, sizeof(value));
+}
+
+static void put_site(tbuffer *buf, tuint32 id, const char *fmt,
+        tuint32 level = TLOG_INFO)
+{
+    t_buffer_append_char(buf, 'S', 1);
+    put_u32(buf, id);
+    put_u32(buf, level);
+    put_u64(buf, 1);
+    const char *strs[] = {"file.c", "func", fmt};
+    for (tuint32 i = 0; i < 3; ++i)
+    {
+        put_u32(buf, strlen(strs[i]) + 1);
+        t_buffer_append(buf, strs[i], strlen(strs[i]) + 1);
+    }
+}
+
+static void put_record(tbuffer *buf, tuint32 id, const char *payload, tuint32 len)
+{
+    t_buffer_append_char(buf, 'R', 1);
+    put_u32(buf, id);
+    put_u64(buf, 0);
+    put_u64(buf, 0);
+    put_u64(buf, 0);
+    put_u32(buf, len);
+    t_buffer_append(buf, payload, len);
+}
+
+TEST(BinaryTest, Corrupted)
+{
+    tbuffer bin, out;
+    t_buffer_init(&bin);
+    t_buffer_init(&out);
+
+    /* call site id out of dictionary */
+    ASSERT_EQ(0, binary_write_header(&bin, "%m%n"));
+    put_site(&bin, 0xffffffff, "huge id");
+    put_site(&bin, 1000000, "large id");
+    put_record(&bin, 0xffffffff, "", 0);
+    EXPECT_EQ(-EINVAL, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(0u, out.len);
+
+    /* packed arguments shorter than format needs */
+    t_buffer_clear(&bin);
+    ASSERT_EQ(0, binary_write_header(&bin, "%m%n"));
+    put_site(&bin, 0, "%s %s %s %.*s");
+    put_record(&bin, 0, "abc", 3);
+    EXPECT_EQ(-EINVAL, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(0u, out.len);
+
+    /* string length out of packed arguments, valid record still decoded */
+    char packed[16] __attribute__((aligned(8))) = {0};
+    tuint32 len = 1000;
+    memcpy(packed, &len, sizeof(len));
+    put_record(&bin, 0, packed, sizeof(packed));
+    put_site(&bin, 1, "ok %d");
+    tint64 value = 5;
+    put_record(&bin, 1, (const char *)&value, sizeof(value));
+    EXPECT_EQ(-EINVAL, binary_decode(bin.data, bin.len, &out));
+    EXPECT_EQ(std::string("ok 5\n"), std::string(out.data, out.len));
+
+    /* level out of range, records before it are still decoded */
+    const tuint32 levels[] = {0x7fffffff, TLOG_FATAL + 1, TLOG_INFO | 0x10000};
+    for (tuint32 i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i)
+    {
+        t_buffer_clear(&bin);
+        t_buffer_clear(&out);
+        ASSERT_EQ(0, binary_write_header(&bin, "%V %m%n"));
+        put_site(&bin, 0, "ok %d");
+        put_record(&bin, 0, (const char *)&value, sizeof(value));
+        put_site(&bin, 1, "bad level", levels[i]);
+        put_record(&bin, 1, "", 0);
+        EXPECT_EQ(-EINVAL, binary_decode(bin.data, bin.len, &out));
+        EXPECT_EQ(std::string("INFO ok 5\n"), std::string(out.data, out.len));
+    }
+
+    t_buffer_free(&bin);
+    t_buffer_free(&out);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
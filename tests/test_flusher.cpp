@@ -0,0 +1,80 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <time.h>
+#include "gtest/gtest.h"
+#include "../src/flusher.h"
+
+static void count_flush(void *userdata)
+{
+    __atomic_add_fetch((int *)userdata, 1, __ATOMIC_RELAXED);
+}
+
+/* wait until count reaches expect, return last count */
+static int wait_count(int *count, int expect)
+{
+    struct timespec ts = {0, 1000000};
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = __atomic_load_n(count, __ATOMIC_RELAXED);
+        if (value >= expect)
+        {
+            return value;
+        }
+        nanosleep(&ts, NULL);
+    }
+
+    return __atomic_load_n(count, __ATOMIC_RELAXED);
+}
+
+#ifdef T_ENABLE_ASSERT
+TEST(FlusherTest, Death)
+{
+    ASSERT_DEATH(flusher_free(NULL), "");
+    ASSERT_DEATH(flusher_kick(NULL), "");
+}
+#endif
+
+TEST(FlusherTest, Interval)
+{
+    int count = 0;
+    flusher *pflusher = flusher_new(10, count_flush, &count);
+    ASSERT_NE((void *)0, pflusher);
+    EXPECT_LE(3, wait_count(&count, 3));
+
+    /* flushed once more when freed */
+    flusher_free(pflusher);
+    int last = count;
+    struct timespec ts = {0, 30000000};
+    nanosleep(&ts, NULL);
+    EXPECT_EQ(last, count);
+}
+
+TEST(FlusherTest, Kick)
+{
+    int count = 0;
+    flusher *pflusher = flusher_new(0, count_flush, &count);
+    ASSERT_NE((void *)0, pflusher);
+
+    /* no interval, only flush when kicked */
+    struct timespec ts = {0, 20000000};
+    nanosleep(&ts, NULL);
+    EXPECT_EQ(0, __atomic_load_n(&count, __ATOMIC_RELAXED));
+
+    flusher_kick(pflusher);
+    EXPECT_EQ(1, wait_count(&count, 1));
+    flusher_kick(pflusher);
+    EXPECT_EQ(2, wait_count(&count, 2));
+
+    flusher_free(pflusher);
+    EXPECT_EQ(3, count);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
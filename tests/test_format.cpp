@@ -3,10 +3,13 @@
  *
  * See the COPYING file for the terms of usage and distribution.
  */
+#include <stdarg.h>
+#include <string>
 #include "gtest/gtest.h"
 #include "../src/format.h"
 #include "../src/tkeyfile.h"
 #include "../src/global.h"
+#include "../src/mdc.h"
 
 char filename[128] = {0};
 
@@ -35,6 +38,378 @@ TEST(FormatTest, Format)
     EXPECT_STREQ("%d(%Y-%m-%d %T).%S %6V [pid:%p tid:%t] [%f:%U:%L] %m%n", get_format(format, "complex"));
 }
 
+TEST(FormatTest, Literal)
+{
+    split_format *splits = format_to_split("%%[%%%V%%]%n%5m|%-5m|%0.2m|end");
+    ASSERT_NE((void *)0, splits);
+
+    tlog_callsite site = {"file.c", "file.c", "func", "1", 1, TLOG_WARN};
+    tbuffer buf;
+    t_buffer_init(&buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.user_msg = "abc";
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("%[%WARN%]\nabc  |  abc|ab|end", buf.data);
+    EXPECT_EQ(strlen(buf.data), buf.len);
+    split_format_free(splits);
+
+    /* numeric specifiers */
+    splits = format_to_split("%L|%-8L|%t|%T|%p|%k|%-8N|");
+    ASSERT_NE((void *)0, splits);
+    site.line = 1234567;
+    thread_identity ident;
+    identity_init(&ident, (pthread_t)0xabc0123, 4322, 4321, "worker");
+    pre.ident = &ident;
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, splits, &pre);
+    char expect[128];
+    snprintf(expect, sizeof(expect), "1234567| 1234567|0x%lx|%lu|4321|4322|  worker|",
+            (unsigned long)0xabc0123, (unsigned long)0xabc0123);
+    EXPECT_STREQ(expect, buf.data);
+
+    t_buffer_free(&buf);
+    split_format_free(splits);
+}
+
+TEST(FormatTest, Time)
+{
+    split_format *splits = format_to_split("%d(%s).%S.%M %D|%-26D|");
+    ASSERT_NE((void *)0, splits);
+
+    tlog_callsite site = {"file.c", "file.c", "func", "1", 1, TLOG_INFO};
+    tbuffer buf;
+    t_buffer_init(&buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.user_msg = "";
+    pre.ts.tv_sec = 1500000000;
+    pre.ts.tv_nsec = 123456789;
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("1500000000.123.123456 2017-07-14T02:40:00.123Z|"
+            "  2017-07-14T02:40:00.123Z|", buf.data);
+    split_format_free(splits);
+
+    /* nanosecond, epoch and uptime */
+    splits = format_to_split("%O|%E|%-22E|%r|%r");
+    ASSERT_NE((void *)0, splits);
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, splits, &pre);
+    pre.ts.tv_nsec = 5;
+    pre.uptime.tv_sec = 12;
+    pre.uptime.tv_nsec = 3400;
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("123456789|1500000000.123456789|  1500000000.123456789|0.000000000|0.000000000"
+            "000000005|1500000000.000000005|  1500000000.000000005|12.000003400|12.000003400",
+            buf.data);
+
+    t_buffer_free(&buf);
+    split_format_free(splits);
+}
+
+TEST(FormatTest, Fold)
+{
+    split_format *splits = format_to_split("%%[%5p]-%c-%m|%-5c|%p");
+    ASSERT_NE((void *)0, splits);
+
+    tlog_callsite site = {"file.c", "file.c", "func", "1", 1, TLOG_INFO};
+    thread_identity ident, other;
+    identity_init(&ident, (pthread_t)1, 2, 4321, NULL);
+    identity_init(&other, (pthread_t)1, 2, 987, NULL);
+    tbuffer buf;
+    t_buffer_init(&buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.user_msg = "msg";
+    pre.ident = &other;
+
+    /* category name is only known by rule */
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("%[987  ]--msg||987", buf.data);
+
+    split_format *folded = format_split_fold(splits, "cat", &ident);
+    ASSERT_NE((void *)0, folded);
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, folded, &pre);
+    EXPECT_STREQ("%[4321 ]-cat-msg|  cat|4321", buf.data);
+    split_format_free(folded);
+
+    folded = format_split_fold(splits, "cat", NULL);
+    ASSERT_NE((void *)0, folded);
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, folded, &pre);
+    EXPECT_STREQ("%[987  ]-cat-msg|  cat|987", buf.data);
+    split_format_free(folded);
+
+    t_buffer_free(&buf);
+    split_format_free(splits);
+}
+
+/* reference json string escape */
+static std::string json_escape(const std::string &str)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
+        char esc[8];
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            }
+            else
+            {
+                out += (char)c;
+            }
+            break;
+        }
+    }
+
+    return out + "\"";
+}
+
+TEST(FormatTest, Json)
+{
+    split_format *splits = format_to_split("%j%n");
+    ASSERT_NE((void *)0, splits);
+    EXPECT_TRUE(format_split_has_mdc(splits));
+
+    tlog_callsite site = {"/path/to/file.c", NULL, "func", "12", 12, TLOG_ERROR};
+    tbuffer buf, msg_buf;
+    t_buffer_init(&buf);
+    t_buffer_init(&msg_buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.msg_buf = &msg_buf;
+    pre.ts.tv_sec = 1500000000;
+    pre.ts.tv_nsec = 123456789;
+
+    /* escaped characters around 16 and 32 bytes block boundaries */
+    const char specials[] = {'"', '\\', '\n', '\r', '\t', '\x01', '\x1f', '\x7f', ' '};
+    for (size_t len = 0; len < 80; ++len)
+    {
+        for (size_t i = 0; i < sizeof(specials); ++i)
+        {
+            std::string msg(len, 'a');
+            for (size_t pos = i; pos < len; pos += 13)
+            {
+                msg[pos] = specials[(pos + i) % sizeof(specials)];
+            }
+            pre.user_msg = msg.c_str();
+            t_buffer_clear(&buf);
+            format_split_to_string(&buf, splits, &pre);
+            std::string expect = "{\"time\":\"2017-07-14T02:40:00.123Z\",\"level\":\"ERROR\","
+                "\"file\":\"file.c\",\"line\":12,\"func\":\"func\",\"msg\":" +
+                json_escape(msg) + "}\n";
+            ASSERT_EQ(expect, std::string(buf.data, buf.len)) << "len " << len;
+        }
+    }
+
+    /* mdc and structured fields are merged into record */
+    mdc *pmdc = mdc_new();
+    ASSERT_NE((void *)0, pmdc);
+    ASSERT_EQ(0, mdc_put(pmdc, "user", "a\"b"));
+    tlog_field fields[2] = {tlog_field_int("count", -3), tlog_field_str("k\n", "v")};
+    pre.user_msg = "done";
+    pre.mdc_handle = pmdc;
+    pre.fields = fields;
+    pre.field_count = 2;
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("{\"time\":\"2017-07-14T02:40:00.123Z\",\"level\":\"ERROR\","
+            "\"file\":\"file.c\",\"line\":12,\"func\":\"func\",\"msg\":\"done\","
+            "\"user\":\"a\\\"b\",\"count\":-3,\"k\\n\":\"v\"}\n", buf.data);
+    mdc_free(pmdc);
+
+    t_buffer_free(&buf);
+    t_buffer_free(&msg_buf);
+    split_format_free(splits);
+}
+
+/* reference control character escape */
+static std::string sanitize(const std::string &str)
+{
+    std::string out;
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
+        char esc[8];
+        if ('\n' == c)
+        {
+            out += "\\n";
+        }
+        else if ('\r' == c)
+        {
+            out += "\\r";
+        }
+        else if ('\t' == c)
+        {
+            out += "\\t";
+        }
+        else if ((c < 0x20) || (0x7f == c))
+        {
+            snprintf(esc, sizeof(esc), "\\x%02x", c);
+            out += esc;
+        }
+        else
+        {
+            out += (char)c;
+        }
+    }
+
+    return out;
+}
+
+/* render record with printf style message */
+static void render_args(tbuffer *buf, const split_format *splits,
+        preprocess_info *pre, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    pre->user_msg = NULL;
+    pre->fmt = fmt;
+    pre->args = &args;
+    format_split_to_string(buf, splits, pre);
+    pre->args = NULL;
+    va_end(args);
+}
+
+TEST(FormatTest, Sanitize)
+{
+    split_format *splits = format_to_split("[%q]");
+    ASSERT_NE((void *)0, splits);
+    split_format *width_splits = format_to_split("[%0.70q]");
+    ASSERT_NE((void *)0, width_splits);
+
+    tlog_callsite site = {"file.c", "file.c", "func", "1", 1, TLOG_INFO};
+    tbuffer buf, msg_buf;
+    t_buffer_init(&buf);
+    t_buffer_init(&msg_buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.msg_buf = &msg_buf;
+
+    /* control characters around 16 and 32 bytes block boundaries */
+    const char specials[] = {'\n', '\r', '\t', '\x1b', '\x01', '\x1f', '\x7f', '"', '\\', ' '};
+    for (size_t len = 0; len < 80; ++len)
+    {
+        for (size_t i = 0; i < sizeof(specials); ++i)
+        {
+            std::string msg(len, 'a');
+            for (size_t pos = i; pos < len; pos += 11)
+            {
+                msg[pos] = specials[(pos + i) % sizeof(specials)];
+            }
+            std::string expect = "[" + sanitize(msg) + "]";
+
+            pre.user_msg = msg.c_str();
+            t_buffer_clear(&buf);
+            format_split_to_string(&buf, splits, &pre);
+            ASSERT_EQ(expect, std::string(buf.data, buf.len)) << "len " << len;
+
+            t_buffer_clear(&buf);
+            render_args(&buf, splits, &pre, "%s", msg.c_str());
+            ASSERT_EQ(expect, std::string(buf.data, buf.len)) << "len " << len;
+
+            expect = "[" + sanitize(msg).substr(0, 70) + "]";
+            t_buffer_clear(&buf);
+            render_args(&buf, width_splits, &pre, "%s", msg.c_str());
+            ASSERT_EQ(expect, std::string(buf.data, buf.len)) << "len " << len;
+        }
+    }
+
+    /* terminal escape sequence can not forge another record */
+    pre.user_msg = "login ok\n2017-01-01 INFO \x1b[2Kadmin login";
+    t_buffer_clear(&buf);
+    format_split_to_string(&buf, splits, &pre);
+    EXPECT_STREQ("[login ok\\n2017-01-01 INFO \\x1b[2Kadmin login]", buf.data);
+
+    t_buffer_free(&buf);
+    t_buffer_free(&msg_buf);
+    split_format_free(splits);
+    split_format_free(width_splits);
+}
+
+struct render_arg
+{
+    const split_format *splits;
+    int index;
+    int errors;
+};
+
+/* render same split format in several threads at the same time */
+static void *render_thread(void *data)
+{
+    render_arg *arg = (render_arg *)data;
+    char line[32];
+    snprintf(line, sizeof(line), "%d", arg->index);
+    tlog_callsite site = {"file.c", "file.c", "func", line, arg->index, TLOG_INFO};
+    char msg[32];
+    snprintf(msg, sizeof(msg), "thread %d", arg->index);
+    char expect[128];
+    snprintf(expect, sizeof(expect), "[    INFO] func:%d thread %d|\n", arg->index, arg->index);
+
+    tbuffer buf, msg_buf;
+    t_buffer_init(&buf);
+    t_buffer_init(&msg_buf);
+    preprocess_info pre;
+    memset(&pre, 0, sizeof(pre));
+    pre.site = &site;
+    pre.user_msg = msg;
+    pre.msg_buf = &msg_buf;
+    for (int i = 0; i < 10000; ++i)
+    {
+        t_buffer_clear(&buf);
+        format_split_to_string(&buf, arg->splits, &pre);
+        if (0 != strcmp(expect, buf.data))
+        {
+            arg->errors++;
+        }
+    }
+    t_buffer_free(&buf);
+    t_buffer_free(&msg_buf);
+
+    return NULL;
+}
+
+TEST(FormatTest, Concurrent)
+{
+    split_format *splits = format_to_split("[%-8V] %U:%L %-4m|%n");
+    ASSERT_NE((void *)0, splits);
+
+    pthread_t tids[4];
+    render_arg args[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        args[i].splits = splits;
+        args[i].index = i;
+        args[i].errors = 0;
+        ASSERT_EQ(0, pthread_create(&tids[i], NULL, render_thread, &args[i]));
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        pthread_join(tids[i], NULL);
+        EXPECT_EQ(0, args[i].errors);
+    }
+
+    split_format_free(splits);
+}
+
 
 int main(int argc, char **argv)
 {
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "gtest/gtest.h"
+#include "../src/identity.h"
+
+static void *thread_identity_check(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "tlog-worker");
+    const thread_identity *ident = identity_current();
+    EXPECT_NE((void *)0, ident);
+    if (NULL != ident)
+    {
+        EXPECT_TRUE(pthread_equal(pthread_self(), ident->tid));
+        EXPECT_EQ((pid_t)syscall(SYS_gettid), ident->ktid);
+        EXPECT_STREQ("tlog-worker", ident->name);
+        EXPECT_EQ(11u, ident->name_len);
+    }
+    return NULL;
+}
+
+TEST(IdentityTest, Init)
+{
+    thread_identity ident;
+    identity_init(&ident, (pthread_t)0x1f, 12, 345, "a very long thread name");
+    EXPECT_STREQ("31", ident.tid_str);
+    EXPECT_EQ(2u, ident.tid_len);
+    EXPECT_STREQ("0x1f", ident.tid_hex_str);
+    EXPECT_EQ(4u, ident.tid_hex_len);
+    EXPECT_STREQ("12", ident.ktid_str);
+    EXPECT_EQ(2u, ident.ktid_len);
+    EXPECT_STREQ("345", ident.pid_str);
+    EXPECT_EQ(3u, ident.pid_len);
+    /* truncated like kernel thread name */
+    EXPECT_STREQ("a very long thr", ident.name);
+    EXPECT_EQ(15u, ident.name_len);
+
+    identity_init(&ident, (pthread_t)0, 0, 1, NULL);
+    EXPECT_STREQ("", ident.name);
+    EXPECT_EQ(0u, ident.name_len);
+}
+
+TEST(IdentityTest, Current)
+{
+    const thread_identity *ident = identity_current();
+    ASSERT_NE((void *)0, ident);
+    EXPECT_EQ(ident, identity_current());
+    EXPECT_EQ(getpid(), ident->pid);
+    EXPECT_EQ(getpid(), ident->ktid);
+
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, thread_identity_check, NULL));
+    pthread_join(thread, NULL);
+}
+
+TEST(IdentityTest, Fork)
+{
+    const thread_identity *ident = identity_current();
+    ASSERT_NE((void *)0, ident);
+    pid_t parent = ident->pid;
+
+    pid_t child = fork();
+    ASSERT_NE(-1, child);
+    if (0 == child)
+    {
+        /* child must not see identity of parent */
+        ident = identity_current();
+        _exit(((NULL != ident) && (ident->pid == getpid()) &&
+               (ident->pid != parent) && (ident->ktid == getpid())) ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+    EXPECT_EQ(parent, identity_current()->pid);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
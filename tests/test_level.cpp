@@ -5,6 +5,8 @@
  */
 #include "gtest/gtest.h"
 #include "../src/level.h"
+/* strip all log macros */
+#define TLOG_MIN_LEVEL TLOG_LEVEL_OFF
 #include "../include/tlog/tlog.h"
 
 
@@ -44,6 +46,23 @@ TEST(LevelTest, Convert)
     EXPECT_EQ((TLOG_FATAL) & LEVEL_MASK, log_level_convert("=fatal"));
 }
 
+static int eval_count(int *count)
+{
+    return ++(*count);
+}
+
+TEST(LevelTest, Strip)
+{
+    int count = 0;
+    tlog_debug(NULL, "%d", eval_count(&count));
+    tlog_info(NULL, "%d", eval_count(&count));
+    tlog_notice(NULL, "%d", eval_count(&count));
+    tlog_warn(NULL, "%d", eval_count(&count));
+    tlog_error(NULL, "%d", eval_count(&count));
+    tlog_fatal(NULL, "%d", eval_count(&count));
+    EXPECT_EQ(0, count);
+}
+
 
 int main(int argc, char **argv)
 {
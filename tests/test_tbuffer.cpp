@@ -0,0 +1,63 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <string>
+#include "gtest/gtest.h"
+#include "../src/tbuffer.h"
+
+static int buffer_printf(tbuffer *buf, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int err = t_buffer_vprintf(buf, fmt, args);
+    va_end(args);
+    return err;
+}
+
+TEST(TbufferTest, Append)
+{
+    tbuffer buf;
+    t_buffer_init(&buf);
+    EXPECT_EQ(0, t_buffer_append(&buf, "hello", 5));
+    EXPECT_EQ(0, t_buffer_append_char(&buf, ' ', 2));
+    EXPECT_EQ(0, t_buffer_append(&buf, "world", 5));
+    EXPECT_EQ(12u, buf.len);
+    EXPECT_STREQ("hello  world", buf.data);
+
+    t_buffer_clear(&buf);
+    EXPECT_EQ(0u, buf.len);
+    EXPECT_STREQ("", buf.data);
+    t_buffer_free(&buf);
+    EXPECT_EQ((char *)NULL, buf.data);
+}
+
+TEST(TbufferTest, Printf)
+{
+    tbuffer buf;
+    t_buffer_init(&buf);
+    EXPECT_EQ(0, buffer_printf(&buf, "%d-%s", 12, "ab"));
+    EXPECT_STREQ("12-ab", buf.data);
+
+    /* large message is never truncated */
+    std::string large(10000, 'x');
+    EXPECT_EQ(0, buffer_printf(&buf, "[%s]", large.c_str()));
+    EXPECT_EQ(5u + 10002u, buf.len);
+    EXPECT_EQ("12-ab[" + large + "]", std::string(buf.data));
+
+    /* memory is reused after clear */
+    char *data = buf.data;
+    t_buffer_clear(&buf);
+    EXPECT_EQ(0, buffer_printf(&buf, "%s", large.c_str()));
+    EXPECT_EQ(data, buf.data);
+    EXPECT_EQ(10000u, buf.len);
+    t_buffer_free(&buf);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
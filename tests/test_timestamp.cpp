@@ -0,0 +1,134 @@
+/**
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "gtest/gtest.h"
+#include "../src/timestamp.h"
+
+static void expect_tm_eq(const struct tm &expect, const struct tm &result)
+{
+    EXPECT_EQ(expect.tm_year, result.tm_year);
+    EXPECT_EQ(expect.tm_mon, result.tm_mon);
+    EXPECT_EQ(expect.tm_mday, result.tm_mday);
+    EXPECT_EQ(expect.tm_hour, result.tm_hour);
+    EXPECT_EQ(expect.tm_min, result.tm_min);
+    EXPECT_EQ(expect.tm_sec, result.tm_sec);
+    EXPECT_EQ(expect.tm_wday, result.tm_wday);
+    EXPECT_EQ(expect.tm_yday, result.tm_yday);
+    EXPECT_EQ(expect.tm_isdst, result.tm_isdst);
+    EXPECT_EQ(expect.tm_gmtoff, result.tm_gmtoff);
+}
+
+TEST(TimestampTest, Utc)
+{
+    const time_t secs[] = {0, -1, 59, 86399, 86400, 951782400, 951868799,
+        1709164800, 4107542400LL, -2208988800LL, 253402300799LL};
+    struct tm expect, result;
+    for (size_t i = 0; i < sizeof(secs) / sizeof(secs[0]); ++i)
+    {
+        gmtime_r(&secs[i], &expect);
+        timestamp_utc(secs[i], &result);
+        expect_tm_eq(expect, result);
+    }
+
+    for (time_t sec = -400LL * 366 * 86400; sec < 400LL * 366 * 86400; sec += 86400 * 7 + 3607)
+    {
+        gmtime_r(&sec, &expect);
+        timestamp_utc(sec, &result);
+        expect_tm_eq(expect, result);
+    }
+
+    char buf[TIMESTAMP_ISO_LEN + 1];
+    timestamp_iso_utc(951782400 + 3723, buf);
+    EXPECT_STREQ("2000-02-29T01:02:03", buf);
+}
+
+TEST(TimestampTest, LocalTime)
+{
+    /* posix rule, no time zone database needed */
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+
+    /* around 2026-03-08 and 2026-11-01 transitions */
+    const time_t starts[] = {1772928000, 1793491200};
+    struct tm expect, result;
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); ++i)
+    {
+        for (time_t sec = starts[i]; sec < starts[i] + 86400; sec += 13)
+        {
+            localtime_r(&sec, &expect);
+            ASSERT_TRUE(timestamp_localtime(sec, &result));
+            expect_tm_eq(expect, result);
+        }
+    }
+
+    unsetenv("TZ");
+    tzset();
+}
+
+TEST(TimestampTest, Render)
+{
+    tuint32 id1 = timestamp_new_id();
+    tuint32 id2 = timestamp_new_id();
+    EXPECT_NE(0u, id1);
+    EXPECT_NE(id1, id2);
+
+    time_t sec = 1500000000;
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char expect[TIMESTAMP_MAX_LEN + 1];
+    strftime(expect, sizeof(expect), "%Y-%m-%d %T", &tm);
+
+    tuint32 len = 0;
+    const char *text = timestamp_render(id1, "%Y-%m-%d %T", sec, &len);
+    ASSERT_NE((void *)0, text);
+    EXPECT_STREQ(expect, text);
+    EXPECT_EQ(strlen(expect), len);
+
+    /* same second is served from cache */
+    EXPECT_EQ(text, timestamp_render(id1, "%Y-%m-%d %T", sec, &len));
+
+    /* other format and other second */
+    EXPECT_STREQ("2017", timestamp_render(id2, "%Y", sec, &len));
+    EXPECT_EQ(4u, len);
+    sec += 1;
+    localtime_r(&sec, &tm);
+    strftime(expect, sizeof(expect), "%Y-%m-%d %T", &tm);
+    EXPECT_STREQ(expect, timestamp_render(id1, "%Y-%m-%d %T", sec, &len));
+}
+
+TEST(TimestampTest, Uptime)
+{
+    struct timespec ts, up, last;
+    timestamp_start();
+    timestamp_now(&ts, &up);
+    EXPECT_EQ(0, up.tv_sec);
+    EXPECT_EQ(0, up.tv_nsec);
+
+    /* monotonic clock is read after some format needs it */
+    timestamp_enable_uptime();
+    timestamp_now(&ts, &last);
+    EXPECT_LT(last.tv_sec, 10);
+    for (int i = 0; i < 1000; ++i)
+    {
+        timestamp_now(&ts, &up);
+        ASSERT_TRUE((up.tv_sec > last.tv_sec) ||
+                ((up.tv_sec == last.tv_sec) && (up.tv_nsec >= last.tv_nsec)));
+        last = up;
+    }
+
+    struct timespec sleep_ts = {0, 20000000};
+    nanosleep(&sleep_ts, NULL);
+    timestamp_now(&ts, &up);
+    EXPECT_GE((up.tv_sec - last.tv_sec) * 1000000000LL + up.tv_nsec - last.tv_nsec, 20000000LL);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
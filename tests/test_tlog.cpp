@@ -6,6 +6,12 @@
 #include "gtest/gtest.h"
 #include "../include/tlog/tlog.h"
 #include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include <string>
+#include <vector>
 
 char filename[128] = {0};
 
@@ -69,6 +75,433 @@ TEST(TlogTest, Function)
     tlog_debug(cat5, "this is thread:");
 }
 
+TEST(TlogTest, Enabled)
+{
+    const tlog_category *cat1 = tlog_get_category("test1");
+    const tlog_category *cat2 = tlog_get_category("test2");
+    ASSERT_NE((void *)0, cat1);
+    ASSERT_NE((void *)0, cat2);
+
+    EXPECT_TRUE(tlog_enabled(cat1, TLOG_DEBUG));
+    EXPECT_TRUE(tlog_enabled(cat1, TLOG_FATAL));
+    EXPECT_TRUE(tlog_enabled(cat2, TLOG_INFO));
+    EXPECT_TRUE(tlog_enabled(cat2, TLOG_ERROR));
+    EXPECT_FALSE(tlog_enabled(cat2, TLOG_DEBUG));
+    EXPECT_FALSE(tlog_enabled(NULL, TLOG_FATAL));
+
+    /* disabled level must not evaluate arguments */
+    int count = 0;
+    tlog_debug(cat2, "%d", ++count);
+    EXPECT_EQ(0, count);
+    tlog_info(cat2, "%d", ++count);
+    EXPECT_EQ(1, count);
+}
+
+TEST(TlogTest, LargeMessage)
+{
+    const tlog_category *cat2 = tlog_get_category("test2");
+    ASSERT_NE((void *)0, cat2);
+
+    /* message larger than any fixed buffer must not be truncated */
+    static char large[8192];
+    memset(large, 'x', sizeof(large) - 1);
+    tlog_info(cat2, "large message: %s", large);
+}
+
+TEST(TlogTest, KeyValue)
+{
+    const tlog_category *cat6 = tlog_get_category("test6");
+    ASSERT_NE((void *)0, cat6);
+
+    tlog_kv(cat6, TLOG_INFO, "login", TLOG_STR("user", "bob"),
+            TLOG_STR("path", "a \"b\""), TLOG_INT("latency_us", -42),
+            TLOG_UINT("bytes", 18446744073709551615ULL), 
+            TLOG_DOUBLE("ratio", 0.5), TLOG_BOOL("ok", 1));
+
+    /* flush output by reopen */
+    tlog_close();
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+
+    FILE *fp = fopen("./test_kv.log", "r");
+    ASSERT_NE((FILE *)NULL, fp);
+    char line[512] = {0};
+    char last[512] = {0};
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        strcpy(last, line);
+    }
+    fclose(fp);
+
+    EXPECT_STREQ("info login user=bob path=\"a \\\"b\\\"\" latency_us=-42 "
+            "bytes=18446744073709551615 ratio=0.5 ok=true "
+            "{\"user\":\"bob\",\"path\":\"a \\\"b\\\"\",\"latency_us\":-42,"
+            "\"bytes\":18446744073709551615,\"ratio\":0.5,\"ok\":true}\n", last);
+}
+
+/* read last line of file */
+static std::string last_line(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        return "";
+    }
+    char line[512] = {0};
+    std::string last;
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        last = line;
+    }
+    fclose(fp);
+
+    return last;
+}
+
+TEST(TlogTest, Prefix)
+{
+    const tlog_category *cat7 = tlog_get_category("test7");
+    ASSERT_NE((void *)0, cat7);
+
+    /* pid and category name are folded when rule is added */
+    tlog_info(cat7, "parent %d", 1);
+    fflush(NULL);
+    char expect[128];
+    snprintf(expect, sizeof(expect), "[%d] [ test7] parent 1\n", (int)getpid());
+    EXPECT_EQ(std::string(expect), last_line("./test_prefix.log"));
+
+    /* forked child must not use folded pid of parent */
+    pid_t child = fork();
+    ASSERT_NE(-1, child);
+    if (0 == child)
+    {
+        tlog_info(cat7, "child %d", 2);
+        fflush(NULL);
+        _exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    snprintf(expect, sizeof(expect), "[%d] [ test7] child 2\n", (int)child);
+    EXPECT_EQ(std::string(expect), last_line("./test_prefix.log"));
+}
+
+/* get file size */
+static long file_size(const char *path)
+{
+    struct stat st;
+    return (0 == stat(path, &st)) ? (long)st.st_size : -1;
+}
+
+TEST(TlogTest, Flush)
+{
+    const tlog_category *cat8 = tlog_get_category("test8");
+    ASSERT_NE((void *)0, cat8);
+
+    /* kept in rule buffer until record of flush level */
+    long size = file_size("./test_flush.log");
+    tlog_info(cat8, "buffered");
+    EXPECT_EQ(size, file_size("./test_flush.log"));
+    tlog_error(cat8, "flushed");
+    EXPECT_LT(size, file_size("./test_flush.log"));
+    EXPECT_NE(std::string::npos, last_line("./test_flush.log").find("flushed"));
+}
+
+TEST(TlogTest, FlushAge)
+{
+    /* flusher thread flushes rule when last flush is older than flush age */
+    tlog_close();
+    ASSERT_EQ(0, tlog_open("[general]\n[format]\n"
+                "[rules]\nage.* = default;./test_age.log;flush_age:200", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("age");
+    ASSERT_NE((void *)0, cat);
+
+    long size = file_size("./test_age.log");
+    tlog_info(cat, "buffered until age expired");
+    EXPECT_EQ(size, file_size("./test_age.log"));
+    struct timespec ts = {0, 1000000};
+    for (int i = 0; (i < 2000) && (size == file_size("./test_age.log")); ++i)
+    {
+        nanosleep(&ts, NULL);
+    }
+    EXPECT_LT(size, file_size("./test_age.log"));
+    EXPECT_NE(std::string::npos, last_line("./test_age.log").find("age expired"));
+
+    /* time suffix is not a size */
+    tlog_close();
+    EXPECT_NE(0, tlog_open("[general]\n[format]\n"
+                "[rules]\nage.* = default;./test_age.log;flush_age:1k", TLOG_MEM));
+    tlog_close();
+
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+TEST(TlogTest, DeferredFormat)
+{
+    /* format built at runtime is released before writer thread renders it */
+    tlog_close();
+    unlink("./test_deferred.log");
+    ASSERT_EQ(0, tlog_open("[general]\nasync = true\ndeferred_format = true\n"
+                "[format]\ndeferred = \"%m%n\"\n"
+                "[rules]\ndeferred.* = deferred;./test_deferred.log", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("deferred");
+    ASSERT_NE((void *)0, cat);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        char *fmt = (char *)malloc(32);
+        ASSERT_NE((void *)0, fmt);
+        snprintf(fmt, 32, "deferred %d %%d", i);
+        tlog_info(cat, fmt, i);
+        memset(fmt, 'x', 31);
+        free(fmt);
+    }
+    tlog_close();
+
+    FILE *fp = fopen("./test_deferred.log", "r");
+    ASSERT_NE((void *)0, fp);
+    char line[64];
+    for (int i = 0; i < 100; ++i)
+    {
+        char expect[64];
+        snprintf(expect, sizeof(expect), "deferred %d %d\n", i, i);
+        ASSERT_NE((void *)0, fgets(line, sizeof(line), fp));
+        EXPECT_STREQ(expect, line);
+    }
+    fclose(fp);
+
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+TEST(TlogTest, Sync)
+{
+    /* flusher thread writes out buffered records when dirty bytes reached */
+    tlog_close();
+    ASSERT_EQ(0, tlog_open("[general]\nsync_bytes = 64\n[format]\n"
+                "[rules]\nsync.* = default;./test_sync.log;buffer:64k", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("sync");
+    ASSERT_NE((void *)0, cat);
+
+    long size = file_size("./test_sync.log");
+    tlog_info(cat, "%s", "this record is longer than dirty bytes of sync threshold");
+    struct timespec ts = {0, 1000000};
+    for (int i = 0; (i < 1000) && (size == file_size("./test_sync.log")); ++i)
+    {
+        nanosleep(&ts, NULL);
+    }
+    EXPECT_LT(size, file_size("./test_sync.log"));
+    EXPECT_NE(std::string::npos, last_line("./test_sync.log").find("sync threshold"));
+
+    tlog_close();
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+/* read all lines of file */
+static void read_lines(const char *path, std::vector<std::string> &lines)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        return;
+    }
+    char line[512] = {0};
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        lines.push_back(line);
+    }
+    fclose(fp);
+}
+
+TEST(TlogTest, Rotate)
+{
+    const char *names[] = {"./test_rotate.log", "./test_rotate.log.1",
+        "./test_rotate.log.2", "./test_rotate.log.3", "./test_rotate.log.next"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        unlink(names[i]);
+    }
+
+    tlog_close();
+    ASSERT_EQ(0, tlog_open("[general]\n[format]\nrotate = \"%m%n\"\n[rules]\n"
+                "rotate.* = rotate;./test_rotate.log;max_size:1k, max_files:2", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("rotate");
+    ASSERT_NE((void *)0, cat);
+    /* next file is pre-opened */
+    EXPECT_EQ(0, file_size("./test_rotate.log.next"));
+
+    /* 64 bytes record, rotated every 16 records */
+    struct timespec ts = {0, 2000000};
+    for (int i = 0; i < 100; ++i)
+    {
+        tlog_info(cat, "record %03d %052d", i, 0);
+        nanosleep(&ts, NULL);
+    }
+    tlog_close();
+
+    /* rotated when size reached, later if next file is not ready */
+    EXPECT_LE(1024, file_size("./test_rotate.log.2"));
+    EXPECT_LE(1024, file_size("./test_rotate.log.1"));
+    EXPECT_NE(-1, file_size("./test_rotate.log"));
+    EXPECT_EQ(-1, file_size("./test_rotate.log.3"));
+    EXPECT_EQ(-1, file_size("./test_rotate.log.next"));
+
+    /* kept records are continuous */
+    std::vector<std::string> lines;
+    read_lines("./test_rotate.log.2", lines);
+    read_lines("./test_rotate.log.1", lines);
+    read_lines("./test_rotate.log", lines);
+    ASSERT_LT(32u, lines.size());
+    int first = 100 - (int)lines.size();
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        char expect[128];
+        snprintf(expect, sizeof(expect), "record %03d %052d\n", first + (int)i, 0);
+        EXPECT_EQ(std::string(expect), lines[i]);
+    }
+
+    /* binary output can not be rotated */
+    EXPECT_NE(0, tlog_open("[general]\n[format]\n[rules]\n"
+                "rotate.* = default;./test_rotate.log;binary, max_size:1k", TLOG_MEM));
+    tlog_close();
+
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+TEST(TlogTest, Switch)
+{
+    glob_t files;
+    if (0 == glob("./test_switch.*.log", 0, NULL, &files))
+    {
+        for (size_t i = 0; i < files.gl_pathc; ++i)
+        {
+            unlink(files.gl_pathv[i]);
+        }
+        globfree(&files);
+    }
+
+    tlog_close();
+    ASSERT_EQ(0, tlog_open("[general]\n[format]\nswitch = \"%m%n\"\n[rules]\n"
+                "switch.* = switch;./test_switch.%d(%s).log", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("switch");
+    ASSERT_NE((void *)0, cat);
+
+    /* file of new second is switched in rotate thread */
+    tlog_info(cat, "first");
+    time_t start = time(NULL);
+    struct timespec ts = {0, 10000000};
+    while (time(NULL) == start)
+    {
+        nanosleep(&ts, NULL);
+    }
+    tlog_info(cat, "boundary");
+    nanosleep(&ts, NULL);
+    tlog_info(cat, "second");
+    tlog_close();
+
+    ASSERT_EQ(0, glob("./test_switch.*.log", 0, NULL, &files));
+    EXPECT_LE(2u, files.gl_pathc);
+    if (2u <= files.gl_pathc)
+    {
+        std::vector<std::string> lines;
+        read_lines(files.gl_pathv[0], lines);
+        ASSERT_LE(1u, lines.size());
+        EXPECT_EQ(std::string("first\n"), lines[0]);
+        EXPECT_EQ(std::string("second\n"), last_line(files.gl_pathv[files.gl_pathc - 1]));
+    }
+    globfree(&files);
+
+    /* size rotating can not be used with time based file name */
+    EXPECT_NE(0, tlog_open("[general]\n[format]\n[rules]\n"
+                "switch.* = default;./test_switch.%d(%s).log;max_size:1k", TLOG_MEM));
+    tlog_close();
+
+    /* expanded file name longer than path buffer */
+    EXPECT_NE(0, tlog_open("[general]\n[format]\n[rules]\n"
+                "switch.* = default;./test_switch.%d(%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c).log",
+                TLOG_MEM));
+    tlog_close();
+
+    /* switched binary file would have no header and call site dictionary */
+    EXPECT_NE(0, tlog_open("[general]\n[format]\n[rules]\n"
+                "switch.* = default;./test_switch.%d(%s).log;binary", TLOG_MEM));
+    tlog_close();
+
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+TEST(TlogTest, PipeCommand)
+{
+    unlink("./test_pipe_cmd.log");
+
+    /* ';' in pipe command is not an options separator */
+    tlog_close();
+    ASSERT_EQ(0, tlog_open("[general]\n[format]\npipe = \"%m%n\"\n[rules]\n"
+                "pipe.* = pipe;| cat > ./test_pipe_cmd.log; true", TLOG_MEM));
+    const tlog_category *cat = tlog_get_category("pipe");
+    ASSERT_NE((void *)0, cat);
+    tlog_info(cat, "piped");
+    /* pipe is closed after command exits */
+    tlog_close();
+
+    EXPECT_EQ(std::string("piped\n"), last_line("./test_pipe_cmd.log"));
+
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+}
+
+TEST(TlogTest, RateLimit)
+{
+    const tlog_category *cat6 = tlog_get_category("test6");
+    ASSERT_NE((void *)0, cat6);
+
+    int evaluated = 0;
+    for (int i = 0; i < 7; ++i)
+    {
+        tlog_info_every_n(cat6, 3, "every %d", i);
+        tlog_info_first_n(cat6, 2, "first %d", i);
+        /* suppressed arguments are not evaluated */
+        tlog_info_ratelimit(cat6, 1, 2, "ratelimit %d", ++evaluated);
+    }
+    EXPECT_EQ(2, evaluated);
+
+    tlog_limit limit = {0, 0, 0};
+    unsigned long suppressed = 0;
+    EXPECT_EQ(1, tlog_ratelimit_check(&limit, 1, 1, &suppressed));
+    EXPECT_EQ(0, tlog_ratelimit_check(&limit, 1, 1, &suppressed));
+    EXPECT_EQ(0, tlog_ratelimit_check(&limit, 1, 1, &suppressed));
+    limit.tat = 0;
+    EXPECT_EQ(1, tlog_ratelimit_check(&limit, 1, 1, &suppressed));
+    EXPECT_EQ(2ul, suppressed);
+
+    /* flush output by reopen */
+    tlog_close();
+    ASSERT_EQ(0, tlog_open(filename, TLOG_FILE));
+
+    FILE *fp = fopen("./test_kv.log", "r");
+    ASSERT_NE((FILE *)NULL, fp);
+    char line[512] = {0};
+    std::vector<std::string> lines;
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        lines.push_back(line);
+    }
+    fclose(fp);
+
+    const char *expect[] = 
+    {
+        "info every 0  {}\n",
+        "info first 0  {}\n",
+        "info ratelimit 1  {}\n",
+        "info first 1  {}\n",
+        "info ratelimit 2  {}\n",
+        "info every 3 (suppressed 2)  {}\n",
+        "info every 6 (suppressed 2)  {}\n",
+    };
+    const size_t count = sizeof(expect) / sizeof(expect[0]);
+    ASSERT_LE(count, lines.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(expect[i], lines[lines.size() - count + i]);
+    }
+}
+
 
 int main(int argc, char **argv)
 {
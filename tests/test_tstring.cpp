@@ -119,6 +119,42 @@ TEST(TstringTest, Convert)
     EXPECT_EQ(FALSE, bool_val);
     EXPECT_TRUE(t_string_to_bool("fALse", &bool_val));
     EXPECT_EQ(FALSE, bool_val);
+
+    char num_str[24];
+    EXPECT_EQ(1u, t_string_from_uint(num_str, 0));
+    EXPECT_STREQ("0", num_str);
+    EXPECT_EQ(5u, t_string_from_uint(num_str, 12345));
+    EXPECT_STREQ("12345", num_str);
+    EXPECT_EQ(20u, t_string_from_uint(num_str, 18446744073709551615ULL));
+    EXPECT_STREQ("18446744073709551615", num_str);
+    EXPECT_EQ(3u, t_string_from_int(num_str, -10));
+    EXPECT_STREQ("-10", num_str);
+    EXPECT_EQ(20u, t_string_from_int(num_str, -9223372036854775807LL - 1));
+    EXPECT_STREQ("-9223372036854775808", num_str);
+
+    char expect[24];
+    for (unsigned long long value = 1; value != 0; value *= 3)
+    {
+        snprintf(expect, sizeof(expect), "%llu", value - 1);
+        EXPECT_EQ(strlen(expect), t_string_from_uint(num_str, value - 1));
+        EXPECT_STREQ(expect, num_str);
+        snprintf(expect, sizeof(expect), "%llx", value);
+        EXPECT_EQ(strlen(expect), t_string_from_hex(num_str, value));
+        EXPECT_STREQ(expect, num_str);
+        if (value > 0xffffffffffffffffULL / 3)
+        {
+            break;
+        }
+    }
+
+    EXPECT_EQ(1u, t_string_from_hex(num_str, 0));
+    EXPECT_STREQ("0", num_str);
+    EXPECT_EQ(2u, t_string_from_hex(num_str, 0xa0));
+    EXPECT_STREQ("a0", num_str);
+    EXPECT_EQ(3u, t_string_from_hex(num_str, 0x100));
+    EXPECT_STREQ("100", num_str);
+    EXPECT_EQ(16u, t_string_from_hex(num_str, 0xfedcba9876543210ULL));
+    EXPECT_STREQ("fedcba9876543210", num_str);
 }
 
 TEST(TstringTest, Trimmed)
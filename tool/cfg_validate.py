@@ -8,6 +8,7 @@
 
 # -*- coding: UTF-8 -*-
 
+import re
 import sys
 
 in_group = False
@@ -96,13 +97,24 @@ def format_validation(line, line_data, data):
                  data[cur_index] == 'L' or \
                  data[cur_index] == 'U' or \
                  data[cur_index] == 'm' or \
+                 data[cur_index] == 'q' or \
                  data[cur_index] == 'n' or \
                  data[cur_index] == 'V' or \
                  data[cur_index] == 'v' or \
                  data[cur_index] == 'S' or \
+                 data[cur_index] == 'D' or \
                  data[cur_index] == 'M' or \
+                 data[cur_index] == 'O' or \
+                 data[cur_index] == 'E' or \
+                 data[cur_index] == 'r' or \
                  data[cur_index] == 't' or \
                  data[cur_index] == 'p' or \
+                 data[cur_index] == 'c' or \
+                 data[cur_index] == 'k' or \
+                 data[cur_index] == 'N' or \
+                 data[cur_index] == 'K' or \
+                 data[cur_index] == 'J' or \
+                 data[cur_index] == 'j' or \
                  data[cur_index] == 'T':
                 cur_index += 1
             elif data[cur_index] == 'X':
@@ -173,6 +185,45 @@ def is_valid_format(value):
 
     
 
+def size_validation(value):
+    match = re.match(r'^[0-9]+[kKmM]?$', value)
+    return match is not None
+
+
+
+def options_validation(line, data, options):
+    for option in options.split(','):
+        option = option.strip()
+        if option.find(':') != -1:
+            kv = option.split(':', 1)
+            key = kv[0].strip()
+            value = kv[1].strip()
+            if key == "buffer" or key == "max_size":
+                if not size_validation(value):
+                    printinfo("error", line, data, "invalid %s value \'%s\'" % (key, value))
+            elif key == "max_files" or key == "flush_age":
+                if re.match(r'^[0-9]+$', value) is None:
+                    printinfo("error", line, data, "invalid %s value \'%s\'" % (key, value))
+            elif key == "flush_level":
+                if value.lstrip('>') not in ("debug", "info", "notice", "warn", "error", "fatal", "*"):
+                    printinfo("error", line, data, "invalid flush_level value \'%s\'" % value)
+            else:
+                printinfo("error", line, data, "unknown option \'%s\'" % option)
+        elif option == "" or \
+           option == "binary":
+            pass
+        else:
+            printinfo("error", line, data, "unknown option \'%s\'" % option)
+
+
+
+def general_validation(line, data, key, value):
+    if key == "sync_interval" or key == "sync_bytes":
+        if re.match(r'^[0-9]+$', value) is None:
+            printinfo("error", line, data, "invalid %s value \'%s\'" % (key, value))
+
+
+
 def rules_validation(line, data, key, value):
     if key.find('.', 0) != -1:
         kv = key.split('.', 2)
@@ -195,10 +246,17 @@ def rules_validation(line, data, key, value):
 
     fmt = ""
     output = ""
+    options = ""
     if value.find(';', 0) != -1:
-        kv = value.split(';', 2)
+        kv = value.split(';', 1)
         fmt = kv[0]
         output = kv[1]
+        # pipe command may contain ';', so pipe output takes no options
+        if not output.lstrip(' ').startswith('|'):
+            kv = output.split(';', 1)
+            output = kv[0]
+            if len(kv) > 1:
+                options = kv[1]
     else:
         fmt = "default"
         output = value
@@ -211,6 +269,7 @@ def rules_validation(line, data, key, value):
         printinfo("error", line, data, "unknown format \'%s\'" % fmt)
         
     output_validation(line, data, output)
+    options_validation(line, data, options)
 
 
 
@@ -229,7 +288,7 @@ def parse_kv(line, data):
             value = kv[1]
             value = value.strip()
             if group_name == "general":
-                pass
+                general_validation(line, data, key, value)
             elif group_name == "format":
                 format_validation(line, data, value)
                 global formats
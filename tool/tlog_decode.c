@@ -0,0 +1,96 @@
+/**
+ * This file is part of the tlog Library.
+ *
+ * Copyright 2017, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include "tbuffer.h"
+#include "binary.h"
+
+/****************************************************
+ * functions
+ ****************************************************/
+/**
+ * @brief read whole file to buffer
+ * @param fd - file handle
+ * @param buf - output buffer
+ * @return error code, 0 means no error
+ */
+static int read_file(FILE *fd, tbuffer *buf)
+{
+    for (;;)
+    {
+        if (0 != t_buffer_reserve(buf, 65536))
+        {
+            return -ENOMEM;
+        }
+
+        size_t len = fread(buf->data + buf->len, 1, buf->size - buf->len - 1, fd);
+        buf->len += len;
+        if (0 == len)
+        {
+            break;
+        }
+    }
+
+    return ferror(fd) ? -EIO : 0;
+}
+
+/**
+ * @brief decode binary log file and write text to stdout
+ *        usage: tlog-decode [file], read from stdin if no file
+ */
+int main(int argc, char **argv)
+{
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [binary log file]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *fd = stdin;
+    if (2 == argc)
+    {
+        fd = fopen(argv[1], "rb");
+        if (NULL == fd)
+        {
+            fprintf(stderr, "open %s failed: %s\n", argv[1], strerror(errno));
+            return 1;
+        }
+    }
+
+    tbuffer data;
+    tbuffer text;
+    t_buffer_init(&data);
+    t_buffer_init(&text);
+
+    int err = read_file(fd, &data);
+    if (stdin != fd)
+    {
+        fclose(fd);
+    }
+
+    if (0 == err)
+    {
+        err = binary_decode(data.data, data.len, &text);
+        fwrite(text.data, 1, text.len, stdout);
+        if (0 != err)
+        {
+            fprintf(stderr, "binary log is truncated or corrupted\n");
+        }
+    }
+    else
+    {
+        fprintf(stderr, "read binary log failed\n");
+    }
+
+    t_buffer_free(&data);
+    t_buffer_free(&text);
+
+    return (0 == err) ? 0 : 1;
+}